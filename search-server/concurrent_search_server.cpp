@@ -0,0 +1,76 @@
+#include "concurrent_search_server.h"
+
+#include <functional>
+#include <utility>
+
+using namespace std;
+
+void ConcurrentSearchServer::AddDocument(int document_id, string_view document,
+                                         DocumentStatus status, const vector<int>& ratings) {
+    Write([&](SearchServer& search_server) {
+        search_server.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+void ConcurrentSearchServer::AddDocuments(const vector<RawDocument>& documents) {
+    Write([&](SearchServer& search_server) {
+        search_server.AddDocuments(documents);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    Write([document_id](SearchServer& search_server) {
+        search_server.RemoveDocument(document_id);
+    });
+}
+
+void ConcurrentSearchServer::SetThreadPool(shared_ptr<ThreadPool> thread_pool) {
+    Write([&thread_pool](SearchServer& search_server) {
+        search_server.SetThreadPool(thread_pool);
+    });
+}
+
+bool ConcurrentSearchServer::ReadIndicator::IsEmpty() const {
+    for (const Slot& slot : slots_) {
+        if (slot.count.load() != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+ConcurrentSearchServer::ReadLock::ReadLock(const ConcurrentSearchServer& owner)
+    : owner_(&owner)
+    , version_(owner.version_.load())
+    , slot_(hash<thread::id>{}(this_thread::get_id()) % READ_INDICATOR_SLOTS) {
+    owner_->read_indicators_[version_].Arrive(slot_);
+    // Taken once: a writer may switch readers to the other copy while the lock is held
+    server_ = &owner_->servers_[owner_->read_server_.load()];
+}
+
+ConcurrentSearchServer::ReadLock::ReadLock(ReadLock&& other) noexcept
+    : owner_(exchange(other.owner_, nullptr))
+    , version_(other.version_)
+    , slot_(other.slot_)
+    , server_(other.server_) {
+}
+
+ConcurrentSearchServer::ReadLock::~ReadLock() {
+    if (owner_ != nullptr) {
+        owner_->read_indicators_[version_].Depart(slot_);
+    }
+}
+
+void ConcurrentSearchServer::WaitForReaders() {
+    // A reader may have taken the version before the switch of read_server_ and
+    // the copy after it, so the readers of both versions are waited for in turn
+    const size_t version = version_.load();
+    const size_t next_version = 1 - version;
+    while (!read_indicators_[next_version].IsEmpty()) {
+        this_thread::yield();
+    }
+    version_.store(next_version);
+    while (!read_indicators_[version].IsEmpty()) {
+        this_thread::yield();
+    }
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <execution>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+// SearchServer which is queried and updated concurrently.
+// Two copies of the index are kept (left-right scheme): readers use one copy
+// without taking any lock while a writer updates the other one, switches
+// readers to it, waits for the readers of the old copy to leave and repeats
+// the update there. Reads never wait for writers, writers are serialized and
+// pay for every update twice.
+class ConcurrentSearchServer {
+public:
+    template <typename StringContainer>
+    explicit ConcurrentSearchServer(const StringContainer& stop_words)
+        : servers_{SearchServer(stop_words), SearchServer(stop_words)} {
+    }
+
+    explicit ConcurrentSearchServer(const SearchServer& search_server)
+        : servers_{search_server, search_server} {
+    }
+
+    explicit ConcurrentSearchServer(SearchServer&& search_server)
+        : servers_{search_server, std::move(search_server)} {
+    }
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    void AddDocuments(const std::vector<RawDocument>& documents);
+
+    void RemoveDocument(int document_id);
+
+    void SetThreadPool(std::shared_ptr<ThreadPool> thread_pool);
+
+    // Keeps the version of the index current at its creation unchanged while it lives.
+    // Writers wait for it, so it must be held only for the duration of a query.
+    class ReadLock {
+    public:
+        explicit ReadLock(const ConcurrentSearchServer& owner);
+
+        ReadLock(ReadLock&& other) noexcept;
+        ReadLock& operator=(ReadLock&&) = delete;
+
+        ~ReadLock();
+
+        const SearchServer& GetServer() const {
+            return *server_;
+        }
+
+    private:
+        const ConcurrentSearchServer* owner_;
+        size_t version_;
+        size_t slot_;
+        const SearchServer* server_;
+    };
+
+    ReadLock LockForRead() const {
+        return ReadLock(*this);
+    }
+
+    // Calls func(const SearchServer&) on the current version of the index and returns its result.
+    // Views into the server must not outlive the call.
+    template <typename Func>
+    auto Read(Func func) const {
+        const ReadLock lock(*this);
+        return func(lock.GetServer());
+    }
+
+    // Accepts the arguments of the SearchServer::FindTopDocuments overloads taking a raw query.
+    // Parsed queries are not forwarded: one parsed by a copy of the index must not reach the other.
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, Args&&... args) const {
+        return Read([&](const SearchServer& search_server) {
+            return search_server.FindTopDocuments(raw_query, std::forward<Args>(args)...);
+        });
+    }
+
+    template <typename ExecutionPolicy, typename... Args,
+              std::enable_if_t<std::is_execution_policy_v<std::decay_t<ExecutionPolicy>>, int> = 0>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, Args&&... args) const {
+        return Read([&](const SearchServer& search_server) {
+            return search_server.FindTopDocuments(policy, raw_query, std::forward<Args>(args)...);
+        });
+    }
+
+    int GetDocumentCount() const {
+        return Read([](const SearchServer& search_server) {
+            return search_server.GetDocumentCount();
+        });
+    }
+
+private:
+    static constexpr size_t READ_INDICATOR_SLOTS = 16;
+
+    // Number of readers of one version, spread over cache lines to keep readers from contending
+    class ReadIndicator {
+    public:
+        void Arrive(size_t slot) {
+            slots_[slot].count.fetch_add(1);
+        }
+
+        void Depart(size_t slot) {
+            slots_[slot].count.fetch_sub(1);
+        }
+
+        bool IsEmpty() const;
+
+    private:
+        struct alignas(64) Slot {
+            std::atomic<int64_t> count = 0;
+        };
+        std::array<Slot, READ_INDICATOR_SLOTS> slots_;
+    };
+
+    SearchServer servers_[2];
+    // Copy the readers are sent to
+    std::atomic<size_t> read_server_ = 0;
+    // Readers arrive at the indicator of the current version
+    std::atomic<size_t> version_ = 0;
+    mutable ReadIndicator read_indicators_[2];
+    std::mutex write_mutex_;
+
+    // Applies update(SearchServer&) to both copies. The update must change them
+    // the same way; if it throws on the first copy, nothing is changed.
+    template <typename Update>
+    void Write(Update update);
+
+    // Waits until all readers of the other copy leave it
+    void WaitForReaders();
+};
+
+template <typename Update>
+void ConcurrentSearchServer::Write(Update update) {
+    std::lock_guard lock(write_mutex_);
+    const size_t read_server = read_server_.load();
+    update(servers_[1 - read_server]);
+    read_server_.store(1 - read_server);
+    WaitForReaders();
+    update(servers_[read_server]);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+#include "document.h"
+#include "posting_list.h"
+
+const size_t DOCUMENT_STATUS_COUNT {4};
+
+// Common conditions on documents, usable as a predicate of FindTopDocuments.
+// Servers recognize it at compile time and check the status against a bitmap of the index
+// before looking at the document, see IndexedDocumentFilter.
+struct DocumentFilter {
+    std::optional<DocumentStatus> status;
+    int min_rating = std::numeric_limits<int>::min();
+    // Ids in [first_id, last_id]
+    int first_id = std::numeric_limits<int>::min();
+    int last_id = std::numeric_limits<int>::max();
+
+    bool operator()(int document_id, DocumentStatus document_status, int rating) const {
+        return (!status || document_status == *status) && rating >= min_rating
+            && document_id >= first_id && document_id <= last_id;
+    }
+};
+
+// Read-only bitmaps of document ordinals by status, owned by a StatusIndex or a mapped snapshot.
+// All bitmaps have word_count words.
+struct StatusIndexView {
+    std::array<const uint64_t*, DOCUMENT_STATUS_COUNT> bits {};
+    size_t word_count = 0;
+};
+
+// Bitmaps of document ordinals by status. Slots of removed documents keep their bits,
+// scoring excludes those documents anyway.
+class StatusIndex {
+public:
+    void Add(DocumentOrdinal ordinal, DocumentStatus status) {
+        const size_t word_count = ordinal / 64 + 1;
+        if (bits_[0].size() < word_count) {
+            for (auto& bits : bits_) {
+                bits.resize(word_count);
+            }
+        }
+        bits_[static_cast<size_t>(status)][ordinal / 64] |= uint64_t{1} << (ordinal % 64);
+    }
+
+    const std::vector<uint64_t>& GetBits(DocumentStatus status) const {
+        return bits_[static_cast<size_t>(status)];
+    }
+
+    // Valid until the next Add
+    StatusIndexView View() const {
+        StatusIndexView view;
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+            view.bits[status] = bits_[status].data();
+        }
+        view.word_count = bits_[0].size();
+        return view;
+    }
+
+private:
+    std::array<std::vector<uint64_t>, DOCUMENT_STATUS_COUNT> bits_;
+};
+
+// DocumentFilter with the status pushed down into a StatusIndex: postings of documents with
+// another status are skipped by a bit test instead of a predicate call on their DocumentData.
+// The remaining conditions are checked on DocumentData, which scoring reads anyway.
+struct IndexedDocumentFilter {
+    const uint64_t* status_bits = nullptr; // null if any status is allowed
+    size_t status_word_count = 0;
+    int min_rating;
+    int first_id;
+    int last_id;
+
+    bool IsAllowed(DocumentOrdinal ordinal) const {
+        return status_bits == nullptr
+            || (ordinal / 64 < status_word_count && ((status_bits[ordinal / 64] >> (ordinal % 64)) & 1));
+    }
+
+    bool operator()(int document_id, DocumentStatus, int rating) const {
+        return rating >= min_rating && document_id >= first_id && document_id <= last_id;
+    }
+};
+
+// Turns a DocumentFilter into an IndexedDocumentFilter, other predicates are scored as they are.
+// Only the status is pushed down: ordinals follow the order of insertion rather than ids,
+// so an id range is no ordinal range, and ratings have no index. min_rating and the id range
+// are still checked per candidate on its DocumentData.
+template <typename DocumentPredicate>
+decltype(auto) PushDownFilter(DocumentPredicate& document_predicate, const StatusIndexView& status_index) {
+    if constexpr (std::is_same_v<std::remove_const_t<DocumentPredicate>, DocumentFilter>) {
+        IndexedDocumentFilter result {nullptr, 0, document_predicate.min_rating,
+                                      document_predicate.first_id, document_predicate.last_id};
+        if (document_predicate.status) {
+            result.status_bits = status_index.bits[static_cast<size_t>(*document_predicate.status)];
+            result.status_word_count = status_index.word_count;
+        }
+        return result;
+    } else {
+        return (document_predicate);
+    }
+}
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <execution>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+#include "document_filter.h"
+#include "posting_list.h"
+#include "score_accumulator.h"
+#include "thread_pool.h"
+#include "top_documents.h"
+
+// Minimal number of postings worth a separate scoring task of the thread pool
+const size_t MIN_POSTINGS_PER_TASK {16384};
+
+// Indexed by DocumentOrdinal, slots of purged documents are reclaimed by SearchServer::PurgeRemovedDocuments
+struct DocumentData {
+    int id;
+    int rating;
+    DocumentStatus status;
+    uint32_t word_count; // without stop words, term freq is posting count / word_count
+};
+
+struct QueryPostings {
+    std::vector<std::pair<PostingListView, double>> plus_postings; // with inverse document freq
+    std::vector<PostingListView> minus_postings;
+};
+
+// Scores documents with ordinals in [first, last) and feeds them into top_documents.
+// Plus words are scored from the highest impact bound (max term freq * idf) down. Once the bounds
+// of the words left sum below the max_count-th best score seen, no new document can get into
+// the top (MaxScore), so the words left only add to the documents scored so far and blocks of
+// their postings without such documents are not decoded. Scores only grow, so documents which
+// can't reach that score with the bounds left are dropped as well.
+// Buffers come from ScoringScratch, so a query allocates nothing once they have grown.
+template <typename DocumentPredicate>
+void ScoreDocumentRange(
+        const QueryPostings& query_postings, const DocumentData* documents,
+        DocumentOrdinal first, DocumentOrdinal last,
+        DocumentPredicate& document_predicate, TopDocumentsCollector& top_documents) {
+
+    const size_t max_count = top_documents.GetMaxCount();
+    if (max_count == 0) {
+        return;
+    }
+
+    ScoringScratch& scratch = ScoringScratch::ForCurrentThread();
+    ScoreAccumulator& document_to_relevance = scratch.document_to_relevance;
+    document_to_relevance.Reset(first, last);
+
+    for (const PostingListView& postings : query_postings.minus_postings) {
+        postings.ForEach(first, last, [&document_to_relevance](DocumentOrdinal ordinal, uint32_t) {
+            document_to_relevance.Exclude(ordinal);
+        });
+    }
+
+    const auto& plus_postings = query_postings.plus_postings;
+    const auto get_max_impact = [&plus_postings](size_t index) {
+        return plus_postings[index].first.GetMaxTermFreq() * plus_postings[index].second;
+    };
+    std::vector<size_t>& order = scratch.word_order;
+    order.resize(plus_postings.size());
+    std::iota(order.begin(), order.end(), 0);
+    // Ties keep the order of the words, std::stable_sort would allocate a buffer
+    std::sort(order.begin(), order.end(), [&get_max_impact](size_t lhs, size_t rhs) {
+        const double lhs_impact = get_max_impact(lhs);
+        const double rhs_impact = get_max_impact(rhs);
+        return lhs_impact > rhs_impact || (lhs_impact == rhs_impact && lhs < rhs);
+    });
+    // remaining_bounds[i] bounds the relevance words order[i..] can add
+    std::vector<double>& remaining_bounds = scratch.remaining_bounds;
+    std::vector<size_t>& remaining_posting_counts = scratch.remaining_posting_counts;
+    remaining_bounds.assign(order.size() + 1, 0.0);
+    remaining_posting_counts.assign(order.size() + 1, 0);
+    for (size_t i = order.size(); i > 0; --i) {
+        remaining_bounds[i - 1] = remaining_bounds[i] + get_max_impact(order[i - 1]);
+        remaining_posting_counts[i - 1] = remaining_posting_counts[i] + plus_postings[order[i - 1]].first.size();
+    }
+
+    // Best scores of the kept documents and of the documents scored so far.
+    // The threshold is read only before the next word, so scores of the last word are not tracked.
+    TopScoreHeap& top_scores = scratch.top_scores;
+    if (order.size() > 1) {
+        top_scores.Reset(first, last, max_count);
+        for (const Document& document : top_documents.GetDocuments()) {
+            top_scores.AddExternal(document.relevance);
+        }
+    }
+    double min_relevance = -std::numeric_limits<double>::infinity();
+
+    bool is_pruning = false;
+    std::vector<DocumentOrdinal>& candidates = scratch.candidates; // sorted, documents left once pruning starts
+    candidates.clear();
+    for (size_t i = 0; i < order.size(); ++i) {
+        const auto& [postings, inverse_document_freq] = plus_postings[order[i]];
+        const bool is_last_word = i + 1 == order.size();
+        if (!is_pruning) {
+            postings.ForEach(first, last, [&, inverse_document_freq = inverse_document_freq](DocumentOrdinal ordinal, uint32_t count) {
+                if (document_to_relevance.IsExcluded(ordinal)) {
+                    return;
+                }
+                if constexpr (std::is_same_v<DocumentPredicate, IndexedDocumentFilter>) {
+                    if (!document_predicate.IsAllowed(ordinal)) {
+                        return;
+                    }
+                }
+                const auto& document_data = documents[ordinal];
+                if (document_predicate(document_data.id, document_data.status, document_data.rating)) {
+                    const double term_freq = count * 1.0 / document_data.word_count;
+                    document_to_relevance.Add(ordinal, term_freq * inverse_document_freq);
+                    if (!is_last_word) {
+                        top_scores.Update(ordinal, document_to_relevance.GetScore(ordinal));
+                    }
+                }
+            });
+        } else {
+            postings.ForEachOf(candidates, [&, inverse_document_freq = inverse_document_freq](DocumentOrdinal ordinal, uint32_t count) {
+                const double term_freq = count * 1.0 / documents[ordinal].word_count;
+                document_to_relevance.Add(ordinal, term_freq * inverse_document_freq);
+                if (!is_last_word) {
+                    top_scores.Update(ordinal, document_to_relevance.GetScore(ordinal));
+                }
+            });
+        }
+        if (is_last_word) {
+            break;
+        }
+        if (top_scores.IsFull()) {
+            // Documents closer than MAX_DELTA_RELEVANCE are ranked by rating
+            min_relevance = std::max(min_relevance, top_scores.GetMin() - MAX_DELTA_RELEVANCE);
+        }
+
+        const double remaining_bound = remaining_bounds[i + 1];
+        if (!is_pruning) {
+            // Collecting candidates pays off only if more postings are left than scored
+            const size_t remaining_posting_count = remaining_posting_counts[i + 1];
+            if (remaining_bound >= min_relevance
+                    || remaining_posting_count <= remaining_posting_counts[0] - remaining_posting_count) {
+                continue;
+            }
+            is_pruning = true;
+            document_to_relevance.ForEach([&](DocumentOrdinal ordinal, double relevance) {
+                if (relevance + remaining_bound < min_relevance) {
+                    document_to_relevance.Exclude(ordinal);
+                } else {
+                    candidates.push_back(ordinal);
+                }
+            });
+            std::sort(candidates.begin(), candidates.end());
+        } else {
+            size_t kept_count = 0;
+            for (size_t j = 0; j < candidates.size(); ++j) {
+                if (document_to_relevance.GetScore(candidates[j]) + remaining_bound < min_relevance) {
+                    document_to_relevance.Exclude(candidates[j]);
+                } else {
+                    candidates[kept_count++] = candidates[j];
+                }
+            }
+            candidates.resize(kept_count);
+        }
+        if (candidates.empty()) {
+            break;
+        }
+    }
+
+    document_to_relevance.ForEach([documents, &top_documents](DocumentOrdinal ordinal, double relevance) {
+        const auto& document_data = documents[ordinal];
+        top_documents.Add({document_data.id, relevance, document_data.rating});
+    });
+}
+
+template <typename DocumentPredicate>
+void ScoreDocuments(
+        const std::execution::sequenced_policy&,
+        const QueryPostings& query_postings, const DocumentData* documents, size_t document_count,
+        DocumentPredicate& document_predicate, TopDocumentsCollector& top_documents) {
+    ScoreDocumentRange(query_postings, documents, 0, document_count, document_predicate, top_documents);
+}
+
+// Ordinal space is split into ranges, each range is scored by its own pool task
+// into a thread local accumulator and partial top documents are merged at the end
+template <typename DocumentPredicate>
+void ScoreDocuments(
+        const std::execution::parallel_policy&, ThreadPool& thread_pool,
+        const QueryPostings& query_postings, const DocumentData* documents, size_t document_count,
+        DocumentPredicate& document_predicate, TopDocumentsCollector& top_documents) {
+
+    size_t posting_count = 0;
+    for (const auto& [postings, _] : query_postings.plus_postings) {
+        posting_count += postings.size();
+    }
+    const size_t task_count = thread_pool.GetTaskCount(posting_count, MIN_POSTINGS_PER_TASK);
+    if (task_count == 1) {
+        ScoreDocumentRange(query_postings, documents, 0, document_count, document_predicate, top_documents);
+        return;
+    }
+    const size_t range_size = (document_count + task_count - 1) / task_count;
+
+    std::vector<TopDocumentsCollector> partial_top_documents(
+            task_count, TopDocumentsCollector(top_documents.GetMaxCount()));
+    thread_pool.ParallelFor(task_count, [&](size_t task) {
+        const size_t first = std::min(task * range_size, document_count);
+        const size_t last = std::min(first + range_size, document_count);
+        ScoreDocumentRange(query_postings, documents, first, last, document_predicate, partial_top_documents[task]);
+    });
+
+    for (const auto& partial : partial_top_documents) {
+        top_documents.Merge(partial);
+    }
+}
+
+template <typename Term>
+void SortUniqueTerms(std::vector<Term>& terms) {
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+}
+
+// Words of the document and both term lists must be sorted by term, every query term is looked up
+// by a binary search starting after the previous one. Returns false if the document has a minus term,
+// otherwise calls on_match(word) for the words of the document among plus_terms in order.
+template <typename Word, typename Term, typename Func>
+bool MatchSortedTerms(const Word* words_begin, const Word* words_end,
+                      const std::vector<Term>& plus_terms, const std::vector<Term>& minus_terms, Func on_match) {
+    const auto is_less = [](const Word& word, Term term) {
+        return word.term < term;
+    };
+    const Word* it = words_begin;
+    for (const Term term : minus_terms) {
+        it = std::lower_bound(it, words_end, term, is_less);
+        if (it == words_end) {
+            break;
+        }
+        if (it->term == term) {
+            return false;
+        }
+    }
+    it = words_begin;
+    for (const Term term : plus_terms) {
+        it = std::lower_bound(it, words_end, term, is_less);
+        if (it == words_end) {
+            break;
+        }
+        if (it->term == term) {
+            on_match(*it);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "term_dictionary.h"
+
+// Inverse document frequencies of terms computed lazily once per epoch.
+// The owner starts a new epoch whenever the document count or document frequencies change,
+// values of older epochs are recomputed on first use.
+// Get may run concurrently as long as no epoch is started, threads racing on a term store the same value.
+class IdfCache {
+public:
+    // Invalidates all values, term_count is the current size of the dictionary
+    void StartEpoch(size_t term_count) {
+        ++epoch_;
+        entries_.resize(term_count);
+    }
+
+    // compute() is called only if the term has no value for the current epoch
+    template <typename Compute>
+    double Get(TermId term, Compute compute) const {
+        Entry& entry = entries_[term];
+        if (entry.epoch.load(std::memory_order_acquire) == epoch_) {
+            return entry.inverse_document_freq.load(std::memory_order_relaxed);
+        }
+        const double inverse_document_freq = compute();
+        entry.inverse_document_freq.store(inverse_document_freq, std::memory_order_relaxed);
+        entry.epoch.store(epoch_, std::memory_order_release);
+        return inverse_document_freq;
+    }
+
+private:
+    struct Entry {
+        std::atomic<uint64_t> epoch {0};
+        std::atomic<double> inverse_document_freq {0.0};
+
+        Entry() = default;
+
+        Entry(const Entry& other)
+            : epoch(other.epoch.load(std::memory_order_relaxed))
+            , inverse_document_freq(other.inverse_document_freq.load(std::memory_order_relaxed)) {
+        }
+
+        Entry& operator=(const Entry& other) {
+            epoch.store(other.epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            inverse_document_freq.store(other.inverse_document_freq.load(std::memory_order_relaxed),
+                                        std::memory_order_relaxed);
+            return *this;
+        }
+    };
+
+    mutable std::vector<Entry> entries_;
+    // Entries start at epoch 0, which is never current
+    uint64_t epoch_ = 1;
+};
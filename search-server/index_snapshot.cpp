@@ -0,0 +1,269 @@
+#include "index_snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "search_server.h"
+
+using namespace std;
+
+namespace {
+
+const uint64_t SNAPSHOT_ALIGNMENT = 8;
+
+uint64_t AlignOffset(uint64_t offset) {
+    return (offset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+}
+
+// Places sections one after another
+class SnapshotLayout {
+public:
+    SnapshotSection Add(uint64_t size) {
+        const SnapshotSection section {AlignOffset(end_), size};
+        end_ = section.offset + size;
+        return section;
+    }
+
+private:
+    uint64_t end_ = sizeof(SnapshotHeader);
+};
+
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const string& path)
+        : out_(path, ios::binary | ios::trunc) {
+    }
+
+    // Pads the file up to the start of the section
+    void StartSection(const SnapshotSection& section) {
+        static const char zeros[SNAPSHOT_ALIGNMENT] = {};
+        out_.write(zeros, section.offset - position_);
+        position_ = section.offset;
+    }
+
+    void Write(const void* data, size_t size) {
+        out_.write(static_cast<const char*>(data), size);
+        position_ += size;
+    }
+
+    template <typename T>
+    void Write(const vector<T>& values) {
+        Write(values.data(), values.size() * sizeof(T));
+    }
+
+    bool Finish() {
+        out_.close();
+        return !out_.fail();
+    }
+
+private:
+    ofstream out_;
+    uint64_t position_ = 0;
+};
+
+// Removes the file on destruction unless it was renamed by Commit
+class TemporaryFile {
+public:
+    explicit TemporaryFile(string path)
+        : path_(move(path)) {
+    }
+
+    TemporaryFile(const TemporaryFile&) = delete;
+    TemporaryFile& operator=(const TemporaryFile&) = delete;
+
+    ~TemporaryFile() {
+        if (!path_.empty()) {
+            error_code error;
+            filesystem::remove(path_, error);
+        }
+    }
+
+    const string& GetPath() const {
+        return path_;
+    }
+
+    void Commit(const string& path) {
+        filesystem::rename(path_, path);
+        path_.clear();
+    }
+
+private:
+    string path_;
+};
+
+} // namespace
+
+void SearchServer::SaveSnapshot(const string& path) const {
+    // Removed documents are not written, the lists having their postings are purged in copies
+    const auto is_removed = [this](DocumentOrdinal ordinal) {
+        const auto it = lower_bound(removed_documents_.begin(), removed_documents_.end(), ordinal,
+            [](const Posting& posting, DocumentOrdinal value) {
+                return posting.ordinal < value;
+            });
+        return it != removed_documents_.end() && it->ordinal == ordinal;
+    };
+    unordered_map<TermId, PostingList> purged_postings;
+    {
+        unordered_map<TermId, vector<DocumentOrdinal>> removed_postings;
+        for (const Posting& removed : removed_documents_) {
+            for (const auto [term, _] : document_to_word_freqs_[removed.ordinal]) {
+                removed_postings[term].push_back(removed.ordinal);
+            }
+        }
+        for (const auto& [term, ordinals] : removed_postings) {
+            PostingList postings = word_to_document_freqs_[term];
+            postings.Erase(ordinals);
+            purged_postings.emplace(term, move(postings));
+        }
+    }
+    const auto get_postings = [&](TermId term) {
+        const auto it = purged_postings.find(term);
+        return it == purged_postings.end() ? word_to_document_freqs_[term].View() : it->second.View();
+    };
+
+    // Stop words and terms having documents sorted by their strings
+    vector<TermId> sorted_terms;
+    for (TermId term = 0; term < terms_.size(); ++term) {
+        if (IsStopTerm(term) || GetDocumentFreq(term) > 0) {
+            sorted_terms.push_back(term);
+        }
+    }
+    sort(sorted_terms.begin(), sorted_terms.end(), [this](TermId lhs, TermId rhs) {
+        return terms_.GetTerm(lhs) < terms_.GetTerm(rhs);
+    });
+
+    vector<uint32_t> term_indexes(terms_.size());
+    vector<SnapshotTerm> snapshot_terms;
+    snapshot_terms.reserve(sorted_terms.size());
+    uint64_t chars_size = 0;
+    uint64_t data_size = 0;
+    uint64_t block_count = 0;
+    uint64_t tail_count = 0;
+    for (size_t index = 0; index < sorted_terms.size(); ++index) {
+        const TermId term = sorted_terms[index];
+        term_indexes[term] = index;
+        const PostingListView postings = get_postings(term);
+        SnapshotTerm snapshot_term {};
+        snapshot_term.chars_offset = chars_size;
+        snapshot_term.chars_size = terms_.GetTerm(term).size();
+        snapshot_term.is_stop = IsStopTerm(term);
+        snapshot_term.data_offset = data_size;
+        snapshot_term.data_size = postings.GetDataSize();
+        snapshot_term.blocks_offset = block_count;
+        snapshot_term.tails_offset = tail_count;
+        snapshot_term.block_count = postings.GetBlockCount();
+        snapshot_term.tail_size = postings.GetTailSize();
+        snapshot_term.posting_count = postings.size();
+        snapshot_term.max_term_freq = postings.GetMaxTermFreq();
+        snapshot_terms.push_back(snapshot_term);
+        chars_size += snapshot_term.chars_size;
+        data_size += snapshot_term.data_size;
+        block_count += snapshot_term.block_count;
+        tail_count += snapshot_term.tail_size;
+    }
+
+    vector<uint64_t> word_offsets;
+    word_offsets.reserve(document_to_word_freqs_.size() + 1);
+    word_offsets.push_back(0);
+    for (DocumentOrdinal ordinal = 0; ordinal < document_to_word_freqs_.size(); ++ordinal) {
+        const size_t word_count = is_removed(ordinal) ? 0 : document_to_word_freqs_[ordinal].size();
+        word_offsets.push_back(word_offsets.back() + word_count);
+    }
+
+    vector<int> document_ids;
+    vector<DocumentOrdinal> document_ordinals;
+    document_ids.reserve(document_ordinals_.size());
+    document_ordinals.reserve(document_ordinals_.size());
+    for (const auto [document_id, ordinal] : document_ordinals_) {
+        document_ids.push_back(document_id);
+        document_ordinals.push_back(ordinal);
+    }
+
+    SnapshotHeader header {};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order_mark = SNAPSHOT_BYTE_ORDER_MARK;
+    SnapshotLayout layout;
+    header.documents = layout.Add(documents_.size() * sizeof(DocumentData));
+    header.document_ids = layout.Add(document_ids.size() * sizeof(int));
+    header.document_ordinals = layout.Add(document_ordinals.size() * sizeof(DocumentOrdinal));
+    header.word_offsets = layout.Add(word_offsets.size() * sizeof(uint64_t));
+    header.words = layout.Add(word_offsets.back() * sizeof(SnapshotWordFreq));
+    header.terms = layout.Add(snapshot_terms.size() * sizeof(SnapshotTerm));
+    header.term_chars = layout.Add(chars_size);
+    header.posting_data = layout.Add(data_size);
+    header.posting_blocks = layout.Add(block_count * sizeof(PostingBlock));
+    header.posting_tails = layout.Add(tail_count * sizeof(Posting));
+    const size_t status_word_count = (documents_.size() + 63) / 64;
+    header.status_bits = layout.Add(status_word_count * DOCUMENT_STATUS_COUNT * sizeof(uint64_t));
+
+    // A process still serving the old snapshot keeps reading it after the rename.
+    // The temporary file is destroyed after the writer, so it is closed before being removed on failure.
+    TemporaryFile temp_file(path + ".tmp"s);
+    SnapshotWriter writer(temp_file.GetPath());
+    writer.Write(&header, sizeof(header));
+
+    writer.StartSection(header.documents);
+    writer.Write(documents_);
+    writer.StartSection(header.document_ids);
+    writer.Write(document_ids);
+    writer.StartSection(header.document_ordinals);
+    writer.Write(document_ordinals);
+    writer.StartSection(header.word_offsets);
+    writer.Write(word_offsets);
+
+    writer.StartSection(header.words);
+    vector<SnapshotWordFreq> words;
+    for (DocumentOrdinal ordinal = 0; ordinal < document_to_word_freqs_.size(); ++ordinal) {
+        if (is_removed(ordinal)) {
+            continue;
+        }
+        words.clear();
+        for (const auto [term, term_freq] : document_to_word_freqs_[ordinal]) {
+            words.push_back({term_indexes[term], 0, term_freq});
+        }
+        sort(words.begin(), words.end(), [](const SnapshotWordFreq& lhs, const SnapshotWordFreq& rhs) {
+            return lhs.term < rhs.term;
+        });
+        writer.Write(words);
+    }
+
+    writer.StartSection(header.terms);
+    writer.Write(snapshot_terms);
+    writer.StartSection(header.term_chars);
+    for (const TermId term : sorted_terms) {
+        const string_view chars = terms_.GetTerm(term);
+        writer.Write(chars.data(), chars.size());
+    }
+    writer.StartSection(header.posting_data);
+    for (const TermId term : sorted_terms) {
+        const PostingListView postings = get_postings(term);
+        writer.Write(postings.GetData(), postings.GetDataSize());
+    }
+    writer.StartSection(header.posting_blocks);
+    for (const TermId term : sorted_terms) {
+        const PostingListView postings = get_postings(term);
+        writer.Write(postings.GetBlocks(), postings.GetBlockCount() * sizeof(PostingBlock));
+    }
+    writer.StartSection(header.posting_tails);
+    for (const TermId term : sorted_terms) {
+        const PostingListView postings = get_postings(term);
+        writer.Write(postings.GetTail(), postings.GetTailSize() * sizeof(Posting));
+    }
+    writer.StartSection(header.status_bits);
+    for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+        // A bitmap may be shorter if the last documents were not added with Add
+        vector<uint64_t> bits = status_index_.GetBits(static_cast<DocumentStatus>(status));
+        bits.resize(status_word_count);
+        writer.Write(bits);
+    }
+
+    if (!writer.Finish()) {
+        throw runtime_error("Can't write snapshot "s + path);
+    }
+    temp_file.Commit(path);
+}
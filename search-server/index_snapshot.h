@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#include "document_scoring.h"
+#include "posting_list.h"
+
+// Binary snapshot of a SearchServer written by SearchServer::SaveSnapshot and
+// served by MappedSearchServer. Structures are stored as they are laid out in
+// memory, so a snapshot can be read only on a machine with the same byte order.
+//
+// The file starts with SnapshotHeader, all sections are 8-byte aligned arrays.
+// Terms, stop words included, are sorted by their strings and a term is
+// referred to by its index in that order, so forward index entries sorted by
+// term are sorted lexicographically too.
+
+const char SNAPSHOT_MAGIC[8] = {'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P'};
+const uint32_t SNAPSHOT_VERSION = 3;
+// Reads as a different value on a machine with another byte order
+const uint32_t SNAPSHOT_BYTE_ORDER_MARK = 0x01020304;
+
+// Bytes [offset, offset + size) of the file
+struct SnapshotSection {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order_mark;
+    SnapshotSection documents;          // DocumentData indexed by DocumentOrdinal
+    SnapshotSection document_ids;       // int, ids of the documents in the index, sorted
+    SnapshotSection document_ordinals;  // DocumentOrdinal of every id in document_ids
+    SnapshotSection word_offsets;       // uint64_t, words of a document are [offset[ordinal], offset[ordinal + 1])
+    SnapshotSection words;              // SnapshotWordFreq
+    SnapshotSection terms;              // SnapshotTerm sorted by term strings
+    SnapshotSection term_chars;         // char, strings of all terms
+    SnapshotSection posting_data;       // uint8_t, compressed posting blocks of all terms
+    SnapshotSection posting_blocks;     // PostingBlock
+    SnapshotSection posting_tails;      // Posting
+    SnapshotSection status_bits;        // uint64_t, a bitmap of document ordinals for every DocumentStatus in turn,
+                                        // each of (documents count + 63) / 64 words
+};
+
+struct SnapshotWordFreq {
+    uint32_t term;
+    uint32_t reserved;
+    double term_freq;
+};
+
+struct SnapshotTerm {
+    uint64_t chars_offset;   // in term_chars
+    uint32_t chars_size;
+    uint32_t is_stop;
+    uint64_t data_offset;    // in posting_data
+    uint64_t data_size;
+    uint64_t blocks_offset;  // index in posting_blocks
+    uint64_t tails_offset;   // index in posting_tails
+    uint32_t block_count;
+    uint32_t tail_size;
+    uint64_t posting_count;
+    double max_term_freq;    // bounds term freqs of the postings
+};
+
+static_assert(std::is_trivially_copyable_v<DocumentData> && sizeof(DocumentData) == 16);
+static_assert(std::is_trivially_copyable_v<PostingBlock> && sizeof(PostingBlock) == 16);
+static_assert(std::is_trivially_copyable_v<Posting> && sizeof(Posting) == 8);
+static_assert(sizeof(SnapshotWordFreq) == 16);
+static_assert(sizeof(SnapshotTerm) == 72);
@@ -2,6 +2,8 @@
 
 #include <chrono>
 #include <iostream>
+#include <string>
+#include <string_view>
 
 #define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
 #define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
@@ -15,9 +17,9 @@ public:
     // с помощью using для удобства
     using Clock = std::chrono::steady_clock;
 
-    LogDuration(const std::string& id) : id_(id), s_(""), os_(std::cerr) {
+    LogDuration(std::string_view id) : id_(id), s_(""), os_(std::cerr) {
     }
-    LogDuration(const std::string& id, std::ostream& os) : id_(id), s_("Operation time"), os_(os) {
+    LogDuration(std::string_view id, std::ostream& os) : id_(id), s_("Operation time"), os_(os) {
     }
 
     ~LogDuration() {
@@ -1,15 +1,29 @@
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 #include <random>
 
+#include "concurrent_search_server.h"
+#include "mapped_search_server.h"
+#include "search_page.h"
+#include "segmented_search_server.h"
 #include "process_queries.h"
+#include "query_stats.h"
 #include "search_server.h"
 #include "request_queue.h"
 #include "document.h"
 #include "paginator.h"
 #include "log_duration.h"
-//#include "remove_duplicates.h"
+#include "string_processing.h"
+#include "remove_duplicates.h"
 
 using namespace std;
 
@@ -118,6 +132,118 @@ vector<string> GenerateQueries(mt19937& generator, const vector<string>& diction
     return queries;
 }
 
+// Words are drawn with a Zipf-like skew, so impact bounds of query words differ a lot
+vector<string> GenerateSkewedQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
+    vector<string> queries;
+    queries.reserve(query_count);
+    for (int i = 0; i < query_count; ++i) {
+        const int word_count = uniform_int_distribution(1, max_word_count)(generator);
+        string query;
+        for (int j = 0; j < word_count; ++j) {
+            if (!query.empty()) {
+                query.push_back(' ');
+            }
+            const double position = pow(uniform_real_distribution<>(0, 1)(generator), 4);
+            query += dictionary[static_cast<size_t>(position * (dictionary.size() - 1))];
+        }
+        queries.push_back(move(query));
+    }
+    return queries;
+}
+
+bool IsSameResult(const vector<Document>& lhs, const vector<Document>& rhs) {
+    return equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Document& l, const Document& r) {
+        return l.id == r.id && l.rating == r.rating && abs(l.relevance - r.relevance) < MAX_DELTA_RELEVANCE;
+    });
+}
+
+// Adds documents with ids [first_id, first_id + texts.size()), every fifth one is BANNED
+template <typename Server>
+void AddGeneratedDocuments(Server& search_server, const vector<string>& texts, int first_id = 0) {
+    for (size_t i = 0; i < texts.size(); ++i) {
+        const int id = first_id + static_cast<int>(i);
+        search_server.AddDocument(id, texts[i], id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL,
+                                  {id % 7, 3});
+    }
+}
+
+// Number of queries lhs and rhs answer differently by status and by a predicate, seq and par
+template <typename LhsServer, typename RhsServer>
+int CountMismatches(const LhsServer& lhs, const RhsServer& rhs, const vector<string>& queries) {
+    const auto is_odd = [](int document_id, DocumentStatus, int) {
+        return document_id % 2 == 1;
+    };
+    int mismatch_count = 0;
+    for (const string& query : queries) {
+        mismatch_count += !IsSameResult(lhs.FindTopDocuments(query), rhs.FindTopDocuments(query));
+        mismatch_count += !IsSameResult(lhs.FindTopDocuments(execution::par, query, DocumentStatus::BANNED),
+                                        rhs.FindTopDocuments(execution::par, query, DocumentStatus::BANNED));
+        mismatch_count += !IsSameResult(lhs.FindTopDocuments(execution::seq, query, is_odd, 20),
+                                        rhs.FindTopDocuments(execution::seq, query, is_odd, 20));
+    }
+    return mismatch_count;
+}
+
+// Number of documents MatchDocuments matches differently from MatchDocument, seq and par,
+// ids go in the reverse order. A missing id among them must throw std::out_of_range.
+template <typename Server>
+int CountMatchMismatches(const Server& search_server, const vector<string>& queries, int missing_id) {
+    const vector<int> document_ids(make_reverse_iterator(search_server.end()), make_reverse_iterator(search_server.begin()));
+    int mismatch_count = 0;
+    for (const string& query : queries) {
+        const auto seq_matches = search_server.MatchDocuments(execution::seq, query, document_ids);
+        const auto par_matches = search_server.MatchDocuments(execution::par, query, document_ids);
+        mismatch_count += seq_matches.size() != document_ids.size() || par_matches.size() != document_ids.size();
+        for (size_t i = 0; i < min({document_ids.size(), seq_matches.size(), par_matches.size()}); ++i) {
+            const auto expected = search_server.MatchDocument(query, document_ids[i]);
+            mismatch_count += seq_matches[i] != expected;
+            mismatch_count += par_matches[i] != expected;
+        }
+    }
+    vector<int> ids_with_missing = document_ids;
+    ids_with_missing.insert(ids_with_missing.begin() + ids_with_missing.size() / 2, missing_id);
+    try {
+        search_server.MatchDocuments(execution::seq, queries[0], ids_with_missing);
+        ++mismatch_count;
+    } catch (const out_of_range&) {
+    }
+    try {
+        search_server.MatchDocuments(execution::par, queries[0], ids_with_missing);
+        ++mismatch_count;
+    } catch (const out_of_range&) {
+    }
+    return mismatch_count;
+}
+
+// Snapshot bytes with corrupt(record) applied to every Record of the section
+template <typename Record, typename Corrupt>
+string CorruptSnapshotRecords(string bytes, const SnapshotSection& section, Corrupt corrupt) {
+    for (uint64_t offset = section.offset; offset < section.offset + section.size; offset += sizeof(Record)) {
+        Record record;
+        memcpy(&record, bytes.data() + offset, sizeof(record));
+        corrupt(record);
+        memcpy(bytes.data() + offset, &record, sizeof(record));
+    }
+    return bytes;
+}
+
+// Former SplitIntoWords, kept as the baseline for the tokenizer benchmark
+vector<string_view> SplitIntoWordsByFind(const string_view str) {
+    vector<string_view> result;
+    int64_t pos = 0;
+    const int64_t pos_end = str.npos;
+    while (true) {
+        int64_t space = str.find(' ', pos);
+        result.push_back(space == pos_end ? str.substr(pos) : str.substr(pos, space - pos));
+        if (space == pos_end) {
+            break;
+        } else {
+            pos = space + 1;
+        }
+    }
+    return result;
+}
+
 template <typename ExecutionPolicy>
 void Test1(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
     LOG_DURATION(mark);
@@ -322,6 +448,664 @@ cout << "MatchDocument"s << endl;
     TEST(seq);
     TEST(par);
 
+cout << endl;
+cout << "Index memory"s << endl;
+    {
+        // Flat posting lists took a Posting per document of every term
+        size_t posting_count = 0;
+        for (const int id : search_server) {
+            posting_count += search_server.GetWordFrequenciesView(id).size();
+        }
+        const size_t flat_size = posting_count * sizeof(Posting);
+        const size_t compressed_size = search_server.GetIndexMemoryUsage();
+        cout << "Flat posting lists: "s << flat_size << " bytes"s << endl;
+        cout << "Compressed posting lists: "s << compressed_size << " bytes, "s
+             << flat_size / static_cast<double>(compressed_size) << "x smaller"s << endl;
+
+        // Shrinking changes no results, documents added afterwards are found as before
+        SearchServer shrunk_server = search_server;
+        shrunk_server.ShrinkToFit();
+        const size_t shrunk_size = shrunk_server.GetIndexMemoryUsage();
+        cout << "Shrunk posting lists: "s << shrunk_size << " bytes, "s
+             << flat_size / static_cast<double>(shrunk_size) << "x smaller"s << endl;
+        SearchServer grown_server = search_server;
+        const auto queries = GenerateQueries(generator, dictionary, 100, 5);
+        const auto texts = GenerateQueries(generator, dictionary, 200, 70);
+        int mismatch_count = CountMismatches(grown_server, shrunk_server, queries);
+        AddGeneratedDocuments(grown_server, texts, documents.size());
+        AddGeneratedDocuments(shrunk_server, texts, documents.size());
+        mismatch_count += CountMismatches(grown_server, shrunk_server, queries);
+        cout << "Shrunk index mismatches: "s << mismatch_count << endl;
+    }
+
+cout << endl;
+cout << "ProcessQueries"s << endl;
+    {
+        const auto queries = GenerateQueries(generator, dictionary, 2'000, 7);
+        size_t document_count = 0;
+        {
+            LOG_DURATION("ProcessQueries"s);
+            for (const auto& documents : ProcessQueries(search_server, queries)) {
+                document_count += documents.size();
+            }
+        }
+        cout << document_count << endl;
+        {
+            LOG_DURATION("ProcessQueriesJoined"s);
+            document_count = ProcessQueriesJoined(search_server, queries).size();
+        }
+        cout << document_count << endl;
+
+        // Every query must be answered as FindTopDocuments answers it, joined results keep the query order
+        const auto documents_lists = ProcessQueries(search_server, queries);
+        const auto joined_documents = ProcessQueriesJoined(search_server, queries);
+        int mismatch_count = documents_lists.size() != queries.size();
+        vector<Document> expected_joined;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const auto expected = search_server.FindTopDocuments(queries[i]);
+            if (i < documents_lists.size()) {
+                mismatch_count += !IsSameResult(expected, documents_lists[i]);
+            }
+            expected_joined.insert(expected_joined.end(), expected.begin(), expected.end());
+        }
+        mismatch_count += !IsSameResult(expected_joined, joined_documents);
+        cout << "ProcessQueries mismatches: "s << mismatch_count << endl;
+    }
+
+cout << endl;
+cout << "AddDocuments"s << endl;
+    {
+        const auto texts = GenerateQueries(generator, dictionary, 2'000, 20);
+        const auto queries = GenerateQueries(generator, dictionary, 200, 4);
+        const auto make_batch = [&texts](int first_id, size_t first, size_t last) {
+            vector<RawDocument> documents;
+            for (size_t i = first; i < last; ++i) {
+                const int id = first_id + static_cast<int>(i);
+                documents.push_back({id, texts[i], id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL,
+                                     {id % 7, 3}});
+            }
+            return documents;
+        };
+
+        SearchServer search_server(dictionary[0]);
+        AddGeneratedDocuments(search_server, texts);
+        SearchServer batch_server(dictionary[0]);
+        SegmentedSearchServer segmented_server(dictionary[0]);
+        // Several batches, so later ones see terms of the earlier ones
+        for (size_t first = 0; first < texts.size(); first += 700) {
+            const auto documents = make_batch(0, first, min(first + 700, texts.size()));
+            batch_server.AddDocuments(documents);
+            segmented_server.AddDocuments(documents);
+        }
+        int mismatch_count = CountMismatches(search_server, batch_server, queries);
+        mismatch_count += CountMismatches(search_server, segmented_server, queries);
+        for (const int id : search_server) {
+            mismatch_count += search_server.GetWordFrequencies(id) != batch_server.GetWordFrequencies(id);
+        }
+
+        // A failing batch must throw what the first failing AddDocument would and add nothing
+        const int existing_id = 9'999;
+        AddGeneratedDocuments(search_server, {"existing document"s}, existing_id);
+        AddGeneratedDocuments(batch_server, {"existing document"s}, existing_id);
+        AddGeneratedDocuments(segmented_server, {"existing document"s}, existing_id);
+        const auto add_sequentially = [&](const vector<RawDocument>& documents) {
+            SearchServer search_server(dictionary[0]);
+            AddGeneratedDocuments(search_server, {"existing document"s}, existing_id);
+            try {
+                for (const RawDocument& document : documents) {
+                    search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+                }
+            } catch (const invalid_argument& e) {
+                return string(e.what());
+            }
+            return "no exception"s;
+        };
+        const auto count_failure_mismatches = [&](auto& server, const vector<RawDocument>& documents) {
+            const int document_count = server.GetDocumentCount();
+            string error = "no exception"s;
+            try {
+                server.AddDocuments(documents);
+            } catch (const invalid_argument& e) {
+                error = e.what();
+            }
+            return (error != add_sequentially(documents)) + (server.GetDocumentCount() != document_count);
+        };
+        const string control_text = "bad\x12word"s;
+        vector<vector<RawDocument>> failing_batches;
+        for (const int invalid_id : {existing_id, -1, 5'000}) {
+            // 5'000 repeats an id of the same batch
+            auto documents = make_batch(5'000, 0, 300);
+            documents[200].id = invalid_id;
+            failing_batches.push_back(documents);
+            // The same batch with an invalid word before the invalid id and after it
+            documents[100].text = control_text;
+            failing_batches.push_back(documents);
+            documents[100].text = texts[100];
+            documents[250].text = control_text;
+            failing_batches.push_back(documents);
+        }
+        failing_batches.push_back(make_batch(5'000, 0, 300));
+        failing_batches.back()[299].text = control_text;
+        for (const auto& documents : failing_batches) {
+            mismatch_count += count_failure_mismatches(batch_server, documents);
+            mismatch_count += count_failure_mismatches(segmented_server, documents);
+        }
+        mismatch_count += CountMismatches(search_server, batch_server, queries);
+        mismatch_count += CountMismatches(search_server, segmented_server, queries);
+        cout << "AddDocuments mismatches: "s << mismatch_count << endl;
+    }
+
+cout << endl;
+cout << "SplitIntoWords"s << endl;
+    {
+        size_t word_count = 0;
+        {
+            LOG_DURATION("find + IsValidWord"s);
+            for (const string& document : documents) {
+                for (const auto word : SplitIntoWordsByFind(document)) {
+                    word_count += none_of(word.begin(), word.end(), [](char c) {
+                        return c >= '\0' && c < ' ';
+                    });
+                }
+            }
+        }
+        cout << word_count << endl;
+        word_count = 0;
+        {
+            LOG_DURATION("SplitIntoValidWords"s);
+            vector<string_view> words;
+            for (const string& document : documents) {
+                word_count += SplitIntoValidWords(document, words);
+            }
+        }
+        cout << word_count << endl;
+    }
+
+cout << endl;
+cout << "Snapshot"s << endl;
+    {
+        const auto texts = GenerateQueries(generator, dictionary, 3'000, 20);
+        SearchServer saved_server(dictionary[0]);
+        AddGeneratedDocuments(saved_server, texts);
+        for (int id = 0; id < 3'000; id += 11) {
+            saved_server.RemoveDocument(id);
+        }
+        const auto path = (filesystem::temp_directory_path() / "search_server_test.snapshot"s).string();
+        saved_server.SaveSnapshot(path);
+
+        const auto queries = GenerateQueries(generator, dictionary, 200, 4);
+        {
+            const MappedSearchServer mapped_server(path);
+            int mismatch_count = CountMismatches(saved_server, mapped_server, queries);
+            mismatch_count += mapped_server.GetDocumentCount() != saved_server.GetDocumentCount();
+            for (const int id : saved_server) {
+                mismatch_count += saved_server.GetWordFrequencies(id) != mapped_server.GetWordFrequencies(id);
+                mismatch_count += saved_server.MatchDocument(queries[id % queries.size()], id)
+                    != mapped_server.MatchDocument(queries[id % queries.size()], id);
+            }
+            // Id 0 is removed
+            const vector<string> match_queries(queries.begin(), queries.begin() + 20);
+            mismatch_count += CountMatchMismatches(mapped_server, match_queries, 0);
+            cout << "Mapped snapshot mismatches: "s << mismatch_count << endl;
+            cout << "MatchDocuments mismatches: "s << CountMatchMismatches(saved_server, match_queries, 0) << endl;
+        }
+        cout << "Temporary file left: "s << filesystem::exists(path + ".tmp"s) << endl;
+        {
+            // Renaming over a directory fails after the temporary file is written
+            const auto directory_path = path + ".dir"s;
+            filesystem::create_directory(directory_path);
+            filesystem::create_directory(directory_path + "/keep"s);
+            try {
+                saved_server.SaveSnapshot(directory_path);
+            } catch (const runtime_error&) {
+            }
+            cout << "Temporary file left after a failure: "s << filesystem::exists(directory_path + ".tmp"s) << endl;
+            filesystem::remove_all(directory_path);
+        }
+
+        string snapshot_bytes;
+        {
+            ifstream in(path, ios::binary);
+            snapshot_bytes.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        }
+        SnapshotHeader header;
+        memcpy(&header, snapshot_bytes.data(), sizeof(header));
+        // Queries on a corrupted snapshot must throw
+        const auto check_corruption = [&path, &queries](string_view mark, const string& bytes) {
+            ofstream(path, ios::binary | ios::trunc).write(bytes.data(), bytes.size());
+            try {
+                const MappedSearchServer corrupted_server(path);
+                for (const string& query : queries) {
+                    corrupted_server.FindTopDocuments(execution::par, query);
+                }
+                cout << mark << ": not detected"s << endl;
+            } catch (const runtime_error& e) {
+                cout << mark << ": "s << e.what() << endl;
+            }
+        };
+        check_corruption("Postings past the posting data"s, CorruptSnapshotRecords<SnapshotTerm>(
+                snapshot_bytes, header.terms, [&header](SnapshotTerm& term) {
+            term.data_offset = header.posting_data.size;
+            term.blocks_offset += 1'000'000;
+        }));
+        check_corruption("Tail ordinals past the documents"s, CorruptSnapshotRecords<Posting>(
+                snapshot_bytes, header.posting_tails, [](Posting& posting) {
+            posting.ordinal += 1'000'000;
+        }));
+        check_corruption("Block ordinals past the documents"s, CorruptSnapshotRecords<PostingBlock>(
+                snapshot_bytes, header.posting_blocks, [](PostingBlock& block) {
+            block.first_ordinal += 1'000'000;
+            block.last_ordinal += 1'000'000;
+        }));
+        check_corruption("Block gaps not matching the skip table"s, CorruptSnapshotRecords<PostingBlock>(
+                snapshot_bytes, header.posting_blocks, [](PostingBlock& block) {
+            block.gap_width = 0;
+        }));
+        filesystem::remove(path);
+    }
+
+cout << endl;
+cout << "ConcurrentSearchServer"s << endl;
+    {
+        const auto texts = GenerateQueries(generator, dictionary, 2'000, 20);
+        const auto queries = GenerateQueries(generator, dictionary, 200, 4);
+        ConcurrentSearchServer concurrent_server(dictionary[0]);
+
+        // Ids are added in increasing order, so a consistent version has no id beyond its document count
+        // and the count read by a thread never decreases
+        atomic<bool> is_writing = true;
+        atomic<int> inconsistency_count = 0;
+        vector<thread> readers;
+        for (int reader = 0; reader < 4; ++reader) {
+            readers.emplace_back([&, reader] {
+                int last_document_count = 0;
+                for (size_t i = reader; is_writing; i = (i + 1) % queries.size()) {
+                    const int document_count = concurrent_server.Read([&](const SearchServer& search_server) {
+                        const int document_count = search_server.GetDocumentCount();
+                        for (const Document& document : search_server.FindTopDocuments(queries[i], DocumentStatus::ACTUAL, 50)) {
+                            inconsistency_count += document.id >= document_count;
+                        }
+                        return document_count;
+                    });
+                    inconsistency_count += document_count < last_document_count;
+                    last_document_count = document_count;
+                    concurrent_server.FindTopDocuments(execution::par, queries[i]);
+                }
+            });
+        }
+        for (size_t i = 0; i < texts.size(); ++i) {
+            const int id = static_cast<int>(i);
+            concurrent_server.AddDocument(id, texts[i], id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL,
+                                          {id % 7, 3});
+        }
+        is_writing = false;
+        for (thread& reader : readers) {
+            reader.join();
+        }
+
+        SearchServer search_server(dictionary[0]);
+        AddGeneratedDocuments(search_server, texts);
+        cout << "Inconsistent reads: "s << inconsistency_count << endl;
+        cout << "Mismatches after writing: "s << CountMismatches(search_server, concurrent_server, queries) << endl;
+    }
+
+cout << endl;
+cout << "SegmentedSearchServer"s << endl;
+    {
+        const int document_count = MAX_ACTIVE_SEGMENT_DOCUMENTS * (SEGMENT_MERGE_FACTOR + 1);
+        const auto texts = GenerateQueries(generator, dictionary, document_count, 20);
+        const auto queries = GenerateQueries(generator, dictionary, 200, 4);
+        SearchServer search_server(dictionary[0]);
+        SegmentedSearchServer segmented_server(dictionary[0]);
+
+        // The first documents fill SEGMENT_MERGE_FACTOR segments, freezing the last of them starts a merge.
+        // Documents removed right after that are removed while the merge runs and replayed on its result.
+        const int first_merged_id = MAX_ACTIVE_SEGMENT_DOCUMENTS * SEGMENT_MERGE_FACTOR;
+        const vector<string> first_texts(texts.begin(), texts.begin() + first_merged_id);
+        const vector<string> last_texts(texts.begin() + first_merged_id, texts.end());
+        AddGeneratedDocuments(search_server, first_texts);
+        AddGeneratedDocuments(segmented_server, first_texts);
+        for (int id = 3; id < first_merged_id; id += 97) {
+            search_server.RemoveDocument(id);
+            segmented_server.RemoveDocument(id);
+        }
+        cout << "Mismatches during a merge: "s << CountMismatches(search_server, segmented_server, queries) << endl;
+
+        AddGeneratedDocuments(search_server, last_texts, first_merged_id);
+        AddGeneratedDocuments(segmented_server, last_texts, first_merged_id);
+        for (int id = 5; id < document_count; id += 89) {
+            search_server.RemoveDocument(id);
+            segmented_server.RemoveDocument(id);
+        }
+        segmented_server.WaitForMerges();
+        cout << "Segments after merging: "s << segmented_server.GetSegmentCount() << endl;
+        cout << "Mismatches after a merge: "s << CountMismatches(search_server, segmented_server, queries) << endl;
+        int match_mismatch_count = segmented_server.GetDocumentCount() != search_server.GetDocumentCount();
+        for (const int id : search_server) {
+            const auto [words, status] = search_server.MatchDocument(queries[id % queries.size()], id);
+            const auto [segment_words, segment_status] = segmented_server.MatchDocument(queries[id % queries.size()], id);
+            match_mismatch_count += status != segment_status
+                || !equal(words.begin(), words.end(), segment_words.begin(), segment_words.end());
+        }
+        cout << "MatchDocument mismatches: "s << match_mismatch_count << endl;
+    }
+    {
+        // Segments merge tier by tier: SEGMENT_MERGE_FACTOR^3 frozen segments end up in one,
+        // every document is rewritten once per tier
+        const size_t tier_count = 3;
+        size_t segment_count = 1;
+        for (size_t tier = 0; tier < tier_count; ++tier) {
+            segment_count *= SEGMENT_MERGE_FACTOR;
+        }
+        const auto texts = GenerateQueries(generator, dictionary, MAX_ACTIVE_SEGMENT_DOCUMENTS, 3);
+        SegmentedSearchServer segmented_server(dictionary[0]);
+        size_t max_segment_count = 0;
+        for (size_t segment = 0; segment < segment_count; ++segment) {
+            vector<RawDocument> documents;
+            documents.reserve(texts.size());
+            for (size_t i = 0; i < texts.size(); ++i) {
+                documents.push_back({static_cast<int>(segment * texts.size() + i), texts[i], DocumentStatus::ACTUAL, {1}});
+            }
+            segmented_server.AddDocuments(documents);
+            segmented_server.WaitForMerges();
+            max_segment_count = max(max_segment_count, segmented_server.GetSegmentCount());
+        }
+        cout << "Most segments during ingestion: "s << max_segment_count
+             << " of at most "s << (SEGMENT_MERGE_FACTOR - 1) * tier_count + 1 << endl;
+        cout << "Segments after ingestion: "s << segmented_server.GetSegmentCount() << endl;
+        cout << "Most merges of a document: "s << segmented_server.GetMaxMergeDepth()
+             << " of at most "s << tier_count << endl;
+    }
+
+cout << endl;
+cout << "Compacting purged documents"s << endl;
+    {
+        const auto texts = GenerateQueries(generator, dictionary, 10'000, 20);
+        const auto queries = GenerateQueries(generator, dictionary, 200, 4);
+        SearchServer compacted_server(dictionary[0]);
+        SearchServer search_server(dictionary[0]);
+        AddGeneratedDocuments(compacted_server, texts);
+        vector<int> removed_ids;
+        for (size_t id = 0; id < texts.size(); ++id) {
+            if (id % 3 == 0) {
+                search_server.AddDocument(id, texts[id], id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL,
+                                          {static_cast<int>(id % 7), 3});
+            } else {
+                removed_ids.push_back(id);
+            }
+        }
+        // Two thirds of the slots are purged at once, which renumbers the rest
+        compacted_server.RemoveDocuments(removed_ids);
+        int mismatch_count = CountMismatches(search_server, compacted_server, queries);
+        AddGeneratedDocuments(compacted_server, texts, texts.size());
+        AddGeneratedDocuments(search_server, texts, texts.size());
+        mismatch_count += CountMismatches(search_server, compacted_server, queries);
+        for (const int id : search_server) {
+            mismatch_count += search_server.GetWordFrequencies(id) != compacted_server.GetWordFrequencies(id);
+            mismatch_count += search_server.MatchDocument(queries[id % queries.size()], id)
+                != compacted_server.MatchDocument(queries[id % queries.size()], id);
+        }
+        cout << "Mismatches after compacting: "s << mismatch_count << endl;
+    }
+
+cout << endl;
+cout << "MaxScore pruning"s << endl;
+    {
+        const auto texts = GenerateSkewedQueries(generator, dictionary, 20'000, 30);
+        const auto queries = GenerateSkewedQueries(generator, dictionary, 300, 6);
+        SearchServer search_server(dictionary[0]);
+        AddGeneratedDocuments(search_server, texts);
+
+        // Top documents can't fill a heap of more than all documents, so nothing is pruned then.
+        // The ranking is total, so a pruned result must be a prefix of the unpruned one.
+        const size_t unpruned_count = texts.size() + 1;
+        int mismatch_count = 0;
+        for (const string& query : queries) {
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                const auto unpruned = search_server.FindTopDocuments(execution::seq, query, status, unpruned_count);
+                for (const size_t max_count : {1, 5, 20}) {
+                    const vector<Document> expected(unpruned.begin(), unpruned.begin() + min(max_count, unpruned.size()));
+                    mismatch_count += !IsSameResult(expected, search_server.FindTopDocuments(execution::seq, query, status, max_count));
+                    mismatch_count += !IsSameResult(expected, search_server.FindTopDocuments(execution::par, query, status, max_count));
+                }
+            }
+        }
+        cout << "Pruned results differing from unpruned: "s << mismatch_count << endl;
+    }
+
+cout << endl;
+cout << "Document filters"s << endl;
+    {
+        const auto texts = GenerateQueries(generator, dictionary, 5'000, 20);
+        const auto queries = GenerateQueries(generator, dictionary, 100, 4);
+        SearchServer search_server(dictionary[0]);
+        // Ids don't follow the order of insertion
+        for (size_t i = 0; i < texts.size(); ++i) {
+            const int id = static_cast<int>((i * 7'919) % texts.size());
+            search_server.AddDocument(id, texts[i], static_cast<DocumentStatus>(id % 3), {id % 7, 3});
+        }
+
+        // A DocumentFilter must give what the same conditions give as a lambda
+        int mismatch_count = 0;
+        for (const DocumentFilter& filter : {
+                DocumentFilter {DocumentStatus::ACTUAL, 3, 1'000, 4'000},
+                DocumentFilter {DocumentStatus::IRRELEVANT, 4, 0, 2'500},
+                DocumentFilter {nullopt, 2, 3'000, 3'500},
+                DocumentFilter {DocumentStatus::REMOVED, 1, 0, 5'000}}) {
+            const auto predicate = [filter](int document_id, DocumentStatus status, int rating) {
+                return (!filter.status || status == *filter.status) && rating >= filter.min_rating
+                    && document_id >= filter.first_id && document_id <= filter.last_id;
+            };
+            for (const string& query : queries) {
+                mismatch_count += !IsSameResult(search_server.FindTopDocuments(execution::seq, query, predicate),
+                                                search_server.FindTopDocuments(execution::seq, query, filter));
+                mismatch_count += !IsSameResult(search_server.FindTopDocuments(execution::par, query, predicate),
+                                                search_server.FindTopDocuments(execution::par, query, filter));
+            }
+        }
+        cout << "Filter mismatches: "s << mismatch_count << endl;
+    }
+
+cout << endl;
+cout << "Result cache"s << endl;
+    {
+        const auto texts = GenerateQueries(generator, dictionary, 5'000, 20);
+        const auto queries = GenerateQueries(generator, dictionary, 100, 4);
+        SearchServer search_server(dictionary[0]);
+        AddGeneratedDocuments(search_server, texts);
+        SearchServer cached_server = search_server;
+        cached_server.SetResultCacheCapacity(1024);
+
+        // Every query runs twice, the second run is answered from the cache
+        int mismatch_count = 0;
+        for (int run = 0; run < 2; ++run) {
+            mismatch_count += CountMismatches(search_server, cached_server, queries);
+        }
+        cached_server.RemoveDocument(1);
+        search_server.RemoveDocument(1);
+        mismatch_count += CountMismatches(search_server, cached_server, queries);
+        const ResultCacheStats stats = cached_server.GetResultCacheStats();
+        cout << "Mismatches with the cache: "s << mismatch_count << endl;
+        cout << "Cache hits: "s << stats.hit_count << ", misses: "s << stats.miss_count
+             << ", invalidations: "s << stats.invalidation_count << endl;
+        cout << "Hits without the cache: "s << search_server.GetResultCacheStats().hit_count << endl;
+    }
+
+cout << endl;
+cout << "Search pages"s << endl;
+    {
+        const auto texts = GenerateQueries(generator, dictionary, 2'000, 20);
+        const auto queries = GenerateQueries(generator, dictionary, 100, 3);
+        SearchServer search_server(dictionary[0]);
+        AddGeneratedDocuments(search_server, texts);
+
+        // Pages put one after another must give all results, an unbounded max count included
+        const size_t unbounded = numeric_limits<size_t>::max();
+        int mismatch_count = 0;
+        for (const string& query : queries) {
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                const vector<Document> expected = search_server.FindTopDocuments(execution::seq, query, status, unbounded);
+                for (const size_t page_size : {size_t{1}, size_t{7}, size_t{100}}) {
+                    vector<Document> documents;
+                    SearchPage page;
+                    size_t page_index = 0;
+                    do {
+                        page = FindTopDocumentsPage(search_server, execution::par, query, status, page_index++, page_size);
+                        documents.insert(documents.end(), page.documents.begin(), page.documents.end());
+                    } while (page.has_next_page);
+                    mismatch_count += !IsSameResult(expected, documents);
+                }
+            }
+        }
+        cout << "Page mismatches: "s << mismatch_count << endl;
+
+        try {
+            FindTopDocumentsPage(search_server, queries[0], unbounded / 2, 3);
+            cout << "Overflowing page: no exception"s << endl;
+        } catch (const out_of_range&) {
+            cout << "Overflowing page: out_of_range"s << endl;
+        }
+        try {
+            FindTopDocumentsPage(search_server, queries[0], DocumentStatus::ACTUAL, 0, 0);
+            cout << "Empty page: no exception"s << endl;
+        } catch (const invalid_argument&) {
+            cout << "Empty page: invalid_argument"s << endl;
+        }
+    }
+
+cout << endl;
+cout << "RemoveDuplicates"s << endl;
+    {
+        SearchServer search_server("and with"s);
+        AddDocument(search_server, 1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+        AddDocument(search_server, 2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+        // дубликат документа 2
+        AddDocument(search_server, 3, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+        // отличие только в стоп-словах
+        AddDocument(search_server, 4, "funny pet and curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+        // множество слов такое же, как в id 1
+        AddDocument(search_server, 5, "funny funny pet and nasty nasty rat"s, DocumentStatus::ACTUAL, {1, 2});
+        AddDocument(search_server, 6, "funny pet and not very nasty rat"s, DocumentStatus::ACTUAL, {1, 2});
+        // слова id 6 в другом порядке
+        AddDocument(search_server, 7, "very nasty rat and not very funny pet"s, DocumentStatus::ACTUAL, {1, 2});
+        AddDocument(search_server, 8, "pet with rat and rat and rat"s, DocumentStatus::ACTUAL, {1, 2});
+        AddDocument(search_server, 9, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+
+        const vector<int> removed_ids = RemoveDuplicates(search_server);
+        const vector<int> expected_ids = {3, 4, 5, 7};
+        int mismatch_count = removed_ids != expected_ids;
+        mismatch_count += search_server.GetDocumentCount() != 5;
+        for (const int id : expected_ids) {
+            mismatch_count += !search_server.GetWordFrequencies(id).empty();
+        }
+        cout << "Removed duplicates:"s;
+        for (const int id : removed_ids) {
+            cout << ' ' << id;
+        }
+        cout << endl;
+        cout << "Duplicate mismatches: "s << mismatch_count << endl;
+    }
+
+cout << endl;
+cout << "Query statistics"s << endl;
+    {
+        using Clock = QueryStatsRecorder::Clock;
+        const Clock::time_point start = Clock::now();
+        const int thread_count = 4;
+        const int record_count = 200;
+
+        // Request i of every thread finishes i ms after start, every fifth one finds nothing
+        QueryStatsRecorder recorder(1024);
+        QueryStatsRecorder small_recorder(64);
+        vector<thread> threads;
+        for (int t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&] {
+                for (int i = 0; i < record_count; ++i) {
+                    recorder.Record(start + chrono::milliseconds(i), chrono::microseconds(i + 1), i % 5);
+                    small_recorder.Record(start + chrono::milliseconds(i), chrono::microseconds(i + 1), i % 5);
+                }
+            });
+        }
+        for (thread& writer : threads) {
+            writer.join();
+        }
+
+        const auto histogram_total = [](const QueryStats& stats) {
+            size_t total = 0;
+            for (const size_t count : stats.result_count_histogram) {
+                total += count;
+            }
+            return total;
+        };
+
+        int mismatch_count = 0;
+        const Clock::time_point end = start + chrono::milliseconds(record_count - 1);
+        const QueryStats all = recorder.GetStats(chrono::hours(1), end);
+        mismatch_count += all.request_count != thread_count * record_count;
+        mismatch_count += all.empty_result_count != thread_count * record_count / 5;
+        mismatch_count += histogram_total(all) != all.request_count;
+        // Counts 0, 1, 2 and 3, 4 are in buckets 0, 1, 2 and 3
+        mismatch_count += all.result_count_histogram[2] != 2 * all.result_count_histogram[1];
+        mismatch_count += all.result_count_histogram[3] != all.result_count_histogram[1];
+        mismatch_count += all.result_count_histogram[4] != 0;
+        mismatch_count += all.latency_max != chrono::microseconds(record_count);
+        mismatch_count += recorder.CountEmptyResults(chrono::hours(1), end) != all.empty_result_count;
+
+        // Only the second half of the requests finished within the window
+        const QueryStats recent = recorder.GetStats(chrono::milliseconds(record_count / 2 - 1), end);
+        mismatch_count += recent.request_count != thread_count * record_count / 2;
+        mismatch_count += recent.empty_result_count != thread_count * record_count / 10;
+        mismatch_count += histogram_total(recent) != recent.request_count;
+        mismatch_count += recorder.GetStats(chrono::hours(1), start - chrono::milliseconds(1)).request_count != 0;
+
+        // After the ring wraps every slot holds one finished record
+        const QueryStats wrapped = small_recorder.GetStats(chrono::hours(1), end);
+        mismatch_count += wrapped.request_count != 64;
+        mismatch_count += histogram_total(wrapped) != wrapped.request_count;
+
+        // Any count falls into the fixed buckets
+        mismatch_count += GetResultCountBucket(1'000'000) != 20;
+        mismatch_count += GetResultCountBucket(numeric_limits<size_t>::max()) != RESULT_COUNT_BUCKETS - 1;
+        QueryStatsRecorder large_recorder(4);
+        large_recorder.Record(end, chrono::microseconds(1), numeric_limits<size_t>::max());
+        mismatch_count += large_recorder.GetStats(chrono::hours(1), end).result_count_histogram.back() != 1;
+
+        // Empty results are counted by whole seconds: request i of every thread finishes
+        // i s after a whole minute. Windows start within a minute, at a whole one and span several.
+        // Counts are not limited by the 64 records kept.
+        const Clock::time_point minute_start(chrono::floor<chrono::minutes>(start.time_since_epoch()));
+        QueryStatsRecorder bucket_recorder(64);
+        threads.clear();
+        for (int t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&] {
+                for (int i = 0; i < record_count; ++i) {
+                    bucket_recorder.Record(minute_start + chrono::seconds(i), chrono::microseconds(1), i % 5);
+                }
+            });
+        }
+        for (thread& writer : threads) {
+            writer.join();
+        }
+        const Clock::time_point bucket_end = minute_start + chrono::seconds(record_count - 1);
+        for (const int first : {0, 60, 61, 130, record_count - 1}) {
+            size_t expected = 0;
+            for (int i = first; i < record_count; ++i) {
+                expected += i % 5 == 0 ? thread_count : 0;
+            }
+            mismatch_count += bucket_recorder.CountEmptyResults(chrono::seconds(record_count - 1 - first), bucket_end)
+                != expected;
+        }
+        mismatch_count += bucket_recorder.CountEmptyResults(chrono::hours(24), bucket_end)
+            != static_cast<size_t>(thread_count * record_count / 5);
+
+        // A second reused by a later lap of the ring is counted by its minute
+        QueryStatsRecorder lap_recorder(64);
+        lap_recorder.Record(minute_start + chrono::seconds(30), chrono::microseconds(1), 0);
+        lap_recorder.Record(minute_start + chrono::seconds(30 + EMPTY_RESULT_SECOND_BUCKETS), chrono::microseconds(1), 0);
+        mismatch_count += lap_recorder.CountEmptyResults(chrono::seconds(20), minute_start + chrono::seconds(40)) != 1;
+        cout << "Statistics mismatches: "s << mismatch_count << endl;
+    }
+
     //SearchServer search_server("and with"s);
 /*
     AddDocument(search_server, 1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {1, 2});
@@ -426,7 +1210,9 @@ cout << "MatchDocument"s << endl;
     cout << "Before duplicates removed: "s << search_server.GetDocumentCount() << endl;
     {
         LOG_DURATION("RemoveDuplicates");
-        RemoveDuplicates(search_server);
+        for (const int document_id : RemoveDuplicates(search_server)) {
+            cout << "Found duplicate document id "s << document_id << endl;
+        }
     }
     cout << "After duplicates removed: "s << search_server.GetDocumentCount() << endl;
 
@@ -453,11 +1239,10 @@ cout << "MatchDocument"s << endl;
     for (int i = 0; i < 1439; ++i) {
         request_queue.AddFindRequest("empty request"s);
     }
-    // все еще 1439 запросов с нулевым результатом
+    // запросы с результатами счётчик не меняют,
+    // за последние сутки все еще 1439 запросов с нулевым результатом
     request_queue.AddFindRequest("curly dog"s);
-    // новые сутки, первый запрос удален, 1438 запросов с нулевым результатом
     request_queue.AddFindRequest("big collar"s);
-    // первый запрос удален, 1437 запросов с нулевым результатом
     request_queue.AddFindRequest("sparrow"s);
     cout << "Total empty requests: "s << request_queue.GetNoResultRequests() << endl;
 */
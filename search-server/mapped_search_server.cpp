@@ -0,0 +1,276 @@
+#include "mapped_search_server.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "string_processing.h"
+
+using namespace std;
+
+namespace {
+
+// Returns the section as an array of T, checks that it lies within the file
+template <typename T>
+const T* GetSection(const MappedFile& file, const SnapshotSection& section, size_t& size) {
+    if (section.offset > file.size() || section.size > file.size() - section.offset
+            || section.offset % alignof(T) != 0 || section.size % sizeof(T) != 0) {
+        throw runtime_error("Snapshot is corrupted"s);
+    }
+    size = section.size / sizeof(T);
+    return reinterpret_cast<const T*>(file.data() + section.offset);
+}
+
+template <typename T>
+const T* GetSection(const MappedFile& file, const SnapshotSection& section) {
+    size_t size;
+    return GetSection<T>(file, section, size);
+}
+
+} // namespace
+
+MappedSearchServer::MappedSearchServer(const string& path)
+    : file_(path) {
+
+    if (file_.size() < sizeof(SnapshotHeader)) {
+        throw runtime_error(path + " is not a snapshot"s);
+    }
+    const auto& header = *reinterpret_cast<const SnapshotHeader*>(file_.data());
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        throw runtime_error(path + " is not a snapshot"s);
+    }
+    if (header.version != SNAPSHOT_VERSION || header.byte_order_mark != SNAPSHOT_BYTE_ORDER_MARK) {
+        throw runtime_error("Snapshot "s + path + " has unsupported version or byte order"s);
+    }
+
+    documents_ = GetSection<DocumentData>(file_, header.documents, document_slot_count_);
+    document_ids_ = GetSection<int>(file_, header.document_ids, document_count_);
+    size_t ordinal_count;
+    document_ordinals_ = GetSection<DocumentOrdinal>(file_, header.document_ordinals, ordinal_count);
+    size_t word_offset_count;
+    word_offsets_ = GetSection<uint64_t>(file_, header.word_offsets, word_offset_count);
+    words_ = GetSection<SnapshotWordFreq>(file_, header.words, word_count_);
+    terms_ = GetSection<SnapshotTerm>(file_, header.terms, term_count_);
+    term_chars_ = GetSection<char>(file_, header.term_chars, term_char_count_);
+    posting_data_ = GetSection<uint8_t>(file_, header.posting_data, posting_data_size_);
+    posting_blocks_ = GetSection<PostingBlock>(file_, header.posting_blocks, posting_block_count_);
+    posting_tails_ = GetSection<Posting>(file_, header.posting_tails, posting_tail_count_);
+    if (ordinal_count != document_count_ || word_offset_count != document_slot_count_ + 1
+            || term_count_ > numeric_limits<TermIndex>::max()) {
+        throw runtime_error("Snapshot is corrupted"s);
+    }
+    checked_terms_ = make_unique<atomic<uint64_t>[]>((term_count_ + 63) / 64);
+
+    size_t status_word_count;
+    const uint64_t* const status_bits = GetSection<uint64_t>(file_, header.status_bits, status_word_count);
+    status_index_.word_count = (document_slot_count_ + 63) / 64;
+    if (status_word_count != status_index_.word_count * DOCUMENT_STATUS_COUNT) {
+        throw runtime_error("Snapshot is corrupted"s);
+    }
+    for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+        status_index_.bits[status] = status_bits + status * status_index_.word_count;
+    }
+}
+
+void MappedSearchServer::SetThreadPool(shared_ptr<ThreadPool> thread_pool) {
+    thread_pool_ = move(thread_pool);
+}
+
+tuple<vector<string_view>, DocumentStatus> MappedSearchServer::MatchDocument(
+        const execution::sequenced_policy&,
+        const string_view raw_query, int document_id) const {
+
+    const DocumentOrdinal ordinal = GetOrdinal(document_id);
+    const DocumentStatus status = documents_[ordinal].status;
+    const auto [words_begin, words_end] = GetWords(ordinal);
+    if (words_begin == words_end) {
+        return {vector<string_view>(), status};
+    }
+
+    return {MatchQuery(ParseQuery(raw_query), ordinal), status};
+}
+
+vector<tuple<vector<string_view>, DocumentStatus>> MappedSearchServer::MatchDocuments(
+        const execution::sequenced_policy&,
+        const string_view raw_query, const vector<int>& document_ids) const {
+
+    vector<DocumentOrdinal> ordinals;
+    ordinals.reserve(document_ids.size());
+    for (const int document_id : document_ids) {
+        ordinals.push_back(GetOrdinal(document_id));
+    }
+    const Query query = ParseQuery(raw_query);
+    vector<tuple<vector<string_view>, DocumentStatus>> results;
+    results.reserve(ordinals.size());
+    for (const DocumentOrdinal ordinal : ordinals) {
+        results.emplace_back(MatchQuery(query, ordinal), documents_[ordinal].status);
+    }
+    return results;
+}
+
+vector<tuple<vector<string_view>, DocumentStatus>> MappedSearchServer::MatchDocuments(
+        const execution::parallel_policy&,
+        const string_view raw_query, const vector<int>& document_ids) const {
+
+    vector<DocumentOrdinal> ordinals;
+    ordinals.reserve(document_ids.size());
+    for (const int document_id : document_ids) {
+        ordinals.push_back(GetOrdinal(document_id));
+    }
+    const Query query = ParseQuery(raw_query);
+    vector<tuple<vector<string_view>, DocumentStatus>> results(ordinals.size());
+
+    const size_t task_count = thread_pool_->GetTaskCount(ordinals.size(), MIN_DOCUMENTS_PER_TASK);
+    const size_t chunk_size = (ordinals.size() + task_count - 1) / task_count;
+    thread_pool_->ParallelFor(task_count, [&](size_t task) {
+        const size_t first = min(task * chunk_size, ordinals.size());
+        const size_t last = min(first + chunk_size, ordinals.size());
+        for (size_t i = first; i < last; ++i) {
+            results[i] = {MatchQuery(query, ordinals[i]), documents_[ordinals[i]].status};
+        }
+    });
+    return results;
+}
+
+vector<string_view> MappedSearchServer::MatchQuery(const Query& query, DocumentOrdinal ordinal) const {
+    vector<string_view> matched_words;
+    const auto [words_begin, words_end] = GetWords(ordinal);
+    const bool is_matched = MatchSortedTerms(words_begin, words_end,
+        query.plus_terms, query.minus_terms, [this, &matched_words](const SnapshotWordFreq& word) {
+            matched_words.push_back(GetTerm(word.term));
+        });
+    if (!is_matched) {
+        return {};
+    }
+    return matched_words;
+}
+
+const map<string_view, double> MappedSearchServer::GetWordFrequencies(int document_id) const {
+    if (!binary_search(begin(), end(), document_id)) {
+        return {};
+    }
+    const DocumentOrdinal ordinal = GetOrdinal(document_id);
+    map<string_view, double> word_freqs;
+    const auto [words_begin, words_end] = GetWords(ordinal);
+    for (const SnapshotWordFreq* word = words_begin; word != words_end; ++word) {
+        word_freqs.emplace(GetTerm(word->term), word->term_freq);
+    }
+    return word_freqs;
+}
+
+string_view MappedSearchServer::GetTerm(TermIndex term) const {
+    if (term >= term_count_) {
+        throw runtime_error("Snapshot is corrupted"s);
+    }
+    const SnapshotTerm& snapshot_term = terms_[term];
+    if (snapshot_term.chars_offset > term_char_count_
+            || snapshot_term.chars_size > term_char_count_ - snapshot_term.chars_offset) {
+        throw runtime_error("Snapshot is corrupted"s);
+    }
+    return {term_chars_ + snapshot_term.chars_offset, snapshot_term.chars_size};
+}
+
+pair<const SnapshotWordFreq*, const SnapshotWordFreq*> MappedSearchServer::GetWords(DocumentOrdinal ordinal) const {
+    const uint64_t first = word_offsets_[ordinal];
+    const uint64_t last = word_offsets_[ordinal + 1];
+    if (first > last || last > word_count_) {
+        throw runtime_error("Snapshot is corrupted"s);
+    }
+    return {words_ + first, words_ + last};
+}
+
+optional<MappedSearchServer::TermIndex> MappedSearchServer::FindTerm(string_view word) const {
+    TermIndex first = 0;
+    TermIndex last = term_count_;
+    while (first < last) {
+        const TermIndex middle = first + (last - first) / 2;
+        if (GetTerm(middle) < word) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    if (first == term_count_ || GetTerm(first) != word) {
+        return nullopt;
+    }
+    return first;
+}
+
+PostingListView MappedSearchServer::GetPostings(TermIndex term) const {
+    const SnapshotTerm& snapshot_term = terms_[term];
+    if (snapshot_term.data_offset > posting_data_size_
+            || snapshot_term.data_size > posting_data_size_ - snapshot_term.data_offset
+            || snapshot_term.blocks_offset > posting_block_count_
+            || snapshot_term.block_count > posting_block_count_ - snapshot_term.blocks_offset
+            || snapshot_term.tails_offset > posting_tail_count_
+            || snapshot_term.tail_size > posting_tail_count_ - snapshot_term.tails_offset) {
+        throw runtime_error("Snapshot is corrupted"s);
+    }
+    const PostingListView postings {
+            posting_data_ + snapshot_term.data_offset, snapshot_term.data_size,
+            posting_blocks_ + snapshot_term.blocks_offset, snapshot_term.block_count,
+            posting_tails_ + snapshot_term.tails_offset, snapshot_term.tail_size,
+            snapshot_term.posting_count, snapshot_term.max_term_freq};
+
+    // Decoded ordinals index documents and score accumulators, so the whole list is checked
+    // before its first use. Racing threads check the same list, which is harmless.
+    atomic<uint64_t>& checked_bits = checked_terms_[term / 64];
+    const uint64_t bit = uint64_t{1} << (term % 64);
+    if ((checked_bits.load(memory_order_relaxed) & bit) == 0) {
+        if (!postings.IsValid(document_slot_count_)) {
+            throw runtime_error("Snapshot is corrupted"s);
+        }
+        checked_bits.fetch_or(bit, memory_order_relaxed);
+    }
+    return postings;
+}
+
+DocumentOrdinal MappedSearchServer::GetOrdinal(int document_id) const {
+    const int* const it = lower_bound(begin(), end(), document_id);
+    if (it == end() || *it != document_id) {
+        throw out_of_range("wrong id");
+    }
+    const DocumentOrdinal ordinal = document_ordinals_[it - begin()];
+    if (ordinal >= document_slot_count_) {
+        throw runtime_error("Snapshot is corrupted"s);
+    }
+    return ordinal;
+}
+
+MappedSearchServer::Query MappedSearchServer::ParseQuery(const string_view text) const {
+    Query result;
+    vector<string_view> raw_words;
+    const size_t invalid_word_index = SplitIntoValidWords(text, raw_words);
+    for (size_t i = 0; i < raw_words.size(); ++i) {
+        const auto [word, is_minus] = ParseQueryWordText(raw_words[i], i != invalid_word_index);
+        const auto term = FindTerm(word);
+        if (term && !terms_[*term].is_stop) {
+            if (is_minus) {
+                result.minus_terms.push_back(*term);
+            } else {
+                result.plus_terms.push_back(*term);
+            }
+        }
+    }
+    // Repeated words are scored once
+    SortUniqueTerms(result.plus_terms);
+    SortUniqueTerms(result.minus_terms);
+    return result;
+}
+
+QueryPostings MappedSearchServer::FindQueryPostings(const Query& query) const {
+    QueryPostings result;
+    for (const TermIndex term : query.plus_terms) {
+        const PostingListView postings = GetPostings(term);
+        if (!postings.empty()) {
+            const double inverse_document_freq = log(GetDocumentCount() * 1.0 / postings.size());
+            result.plus_postings.push_back({postings, inverse_document_freq});
+        }
+    }
+    for (const TermIndex term : query.minus_terms) {
+        result.minus_postings.push_back(GetPostings(term));
+    }
+    return result;
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <atomic>
+#include <execution>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "document.h"
+#include "document_filter.h"
+#include "document_scoring.h"
+#include "index_snapshot.h"
+#include "mapped_file.h"
+#include "search_server.h"
+#include "thread_pool.h"
+#include "top_documents.h"
+
+// Read-only search server over a snapshot written by SearchServer::SaveSnapshot.
+// Opening takes constant time, the snapshot is memory-mapped and its pages
+// are read in by the queries touching them. Results are the same as of
+// the SearchServer the snapshot was written from, status filters use the bitmaps
+// stored in the snapshot.
+// Only the header and section sizes are validated on open, offsets into the sections are checked
+// when they are read and a posting list is decoded and checked as a whole on its first use,
+// so queries throw std::runtime_error on a corrupted snapshot.
+class MappedSearchServer {
+public:
+    // Throws std::runtime_error if the file is not a snapshot of a supported version
+    explicit MappedSearchServer(const std::string& path);
+
+    void SetThreadPool(std::shared_ptr<ThreadPool> thread_pool);
+
+    ThreadPool& GetThreadPool() const {
+        return *thread_pool_;
+    }
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(
+            ExecutionPolicy&& policy,
+            const std::string_view raw_query, DocumentPredicate document_predicate,
+            size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(
+            const std::string_view raw_query, DocumentPredicate document_predicate,
+            size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const {
+        return FindTopDocuments(std::execution::seq, raw_query, document_predicate, max_result_count);
+    }
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(
+            ExecutionPolicy&& policy,
+            const std::string_view raw_query, DocumentStatus status,
+            size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const {
+        return FindTopDocuments(policy, raw_query, DocumentFilter {status}, max_result_count);
+    }
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(
+            ExecutionPolicy&& policy, const std::string_view raw_query) const {
+        return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+    }
+
+    std::vector<Document> FindTopDocuments(
+            std::string_view raw_query, DocumentStatus status,
+            size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const {
+        return FindTopDocuments(std::execution::seq, raw_query, status, max_result_count);
+    }
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const {
+        return FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
+    }
+
+    int GetDocumentCount() const {
+        return document_count_;
+    }
+
+    // Matched words point into the mapping and stay valid while the server lives
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+            const std::execution::sequenced_policy&,
+            const std::string_view raw_query, int document_id) const;
+
+    // Too little work to split, see SearchServer::MatchDocument
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+            const std::execution::parallel_policy&,
+            const std::string_view raw_query, int document_id) const {
+        return MatchDocument(std::execution::seq, raw_query, document_id);
+    }
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+            const std::string_view raw_query, int document_id) const {
+        return MatchDocument(std::execution::seq, raw_query, document_id);
+    }
+
+    // Matches the query parsed once against every document, results follow document_ids.
+    // Throws std::out_of_range if any of the documents is missing.
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(
+            const std::execution::sequenced_policy&,
+            const std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(
+            const std::execution::parallel_policy&,
+            const std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(
+            const std::string_view raw_query, const std::vector<int>& document_ids) const {
+        return MatchDocuments(std::execution::seq, raw_query, document_ids);
+    }
+
+    // Ids of the documents in increasing order
+    const int* begin() const {
+        return document_ids_;
+    }
+
+    const int* end() const {
+        return document_ids_ + document_count_;
+    }
+
+    // Empty for a missing document
+    const std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+
+private:
+    // Index of a term in the sorted term table of the snapshot
+    using TermIndex = uint32_t;
+
+    MappedFile file_;
+    const DocumentData* documents_ = nullptr;
+    size_t document_slot_count_ = 0;
+    StatusIndexView status_index_;
+    const int* document_ids_ = nullptr;
+    const DocumentOrdinal* document_ordinals_ = nullptr;
+    size_t document_count_ = 0;
+    const uint64_t* word_offsets_ = nullptr;
+    const SnapshotWordFreq* words_ = nullptr;
+    size_t word_count_ = 0;
+    const SnapshotTerm* terms_ = nullptr;
+    size_t term_count_ = 0;
+    const char* term_chars_ = nullptr;
+    size_t term_char_count_ = 0;
+    const uint8_t* posting_data_ = nullptr;
+    size_t posting_data_size_ = 0;
+    const PostingBlock* posting_blocks_ = nullptr;
+    size_t posting_block_count_ = 0;
+    const Posting* posting_tails_ = nullptr;
+    size_t posting_tail_count_ = 0;
+    // Bit per term, set once its posting list is checked
+    std::unique_ptr<std::atomic<uint64_t>[]> checked_terms_;
+    std::shared_ptr<ThreadPool> thread_pool_ = ThreadPool::GetDefault();
+
+    // Checks the range against the term table
+    std::string_view GetTerm(TermIndex term) const;
+
+    // Words of the document sorted by term, the range is checked against the words section
+    std::pair<const SnapshotWordFreq*, const SnapshotWordFreq*> GetWords(DocumentOrdinal ordinal) const;
+
+    std::optional<TermIndex> FindTerm(std::string_view word) const;
+
+    // The list is checked on its first use
+    PostingListView GetPostings(TermIndex term) const;
+
+    // Throws std::out_of_range for a missing document
+    DocumentOrdinal GetOrdinal(int document_id) const;
+
+    struct Query {
+        std::vector<TermIndex> plus_terms;
+        std::vector<TermIndex> minus_terms;
+    };
+
+    // Validates words the same way SearchServer does, terms are sorted and unique
+    Query ParseQuery(const std::string_view text) const;
+
+    // Term indexes follow the order of the words, so matched words come sorted
+    std::vector<std::string_view> MatchQuery(const Query& query, DocumentOrdinal ordinal) const;
+
+    QueryPostings FindQueryPostings(const Query& query) const;
+};
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> MappedSearchServer::FindTopDocuments(
+        ExecutionPolicy&& policy,
+        const std::string_view raw_query, DocumentPredicate document_predicate,
+        size_t max_result_count) const {
+
+    const QueryPostings query_postings = FindQueryPostings(ParseQuery(raw_query));
+
+    TopDocumentsCollector top_documents(max_result_count);
+    auto&& scoring_predicate = PushDownFilter(document_predicate, status_index_);
+
+    if constexpr (std::is_same_v<decltype(policy), decltype(std::execution::seq)&>) {
+        ScoreDocuments(std::execution::seq, query_postings, documents_, document_slot_count_,
+                       scoring_predicate, top_documents);
+    } else if constexpr (std::is_same_v<decltype(policy), decltype(std::execution::par)&>) {
+        ScoreDocuments(std::execution::par, *thread_pool_, query_postings, documents_, document_slot_count_,
+                       scoring_predicate, top_documents);
+    }
+
+    return top_documents.Extract();
+}
@@ -3,7 +3,9 @@
 #include <utility>
 #include <iostream>
 #include <algorithm>
-#include <vector>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
 
 template <typename Iterator>
 class IteratorRange {
@@ -39,34 +41,90 @@ std::ostream& operator<<(std::ostream& out, const IteratorRange<Iterator>& range
     return out;
 }
 
+// Splits [begin, end) into pages of page_size elements, the last one may be shorter.
+// Pages are made on the fly while iterating, only the bounds are stored.
 template <typename Iterator>
 class Paginator {
 public:
-    Paginator(Iterator begin, Iterator end, size_t page_size) {
-        for (size_t left = distance(begin, end); left > 0;) {
-            const size_t current_page_size = std::min(page_size, left);
-            const Iterator current_page_end = next(begin, current_page_size);
-            pages_.push_back({begin, current_page_end});
-
-            left -= current_page_size;
-            begin = current_page_end;
+    class PageIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = IteratorRange<Iterator>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        PageIterator(Iterator page_begin, Iterator end, size_t page_size)
+            : page_begin_(page_begin)
+            , end_(end)
+            , page_size_(page_size) {
+        }
+
+        value_type operator*() const {
+            return {page_begin_, GetPageEnd()};
+        }
+
+        PageIterator& operator++() {
+            page_begin_ = GetPageEnd();
+            return *this;
+        }
+
+        PageIterator operator++(int) {
+            PageIterator result = *this;
+            ++*this;
+            return result;
         }
+
+        bool operator==(const PageIterator& other) const {
+            return page_begin_ == other.page_begin_;
+        }
+
+        bool operator!=(const PageIterator& other) const {
+            return page_begin_ != other.page_begin_;
+        }
+
+    private:
+        Iterator page_begin_;
+        Iterator end_;
+        size_t page_size_;
+
+        Iterator GetPageEnd() const {
+            using Category = typename std::iterator_traits<Iterator>::iterator_category;
+            if constexpr (std::is_base_of_v<std::random_access_iterator_tag, Category>) {
+                return page_begin_ + std::min<std::ptrdiff_t>(page_size_, end_ - page_begin_);
+            } else {
+                Iterator page_end = page_begin_;
+                for (size_t i = 0; i < page_size_ && page_end != end_; ++i) {
+                    ++page_end;
+                }
+                return page_end;
+            }
+        }
+    };
+
+    // page_size must be positive
+    Paginator(Iterator begin, Iterator end, size_t page_size)
+        : begin_(begin)
+        , end_(end)
+        , page_size_(page_size) {
     }
 
-    auto begin() const {
-        return pages_.begin();
+    PageIterator begin() const {
+        return {begin_, end_, page_size_};
     }
 
-    auto end() const {
-        return pages_.end();
+    PageIterator end() const {
+        return {end_, end_, page_size_};
     }
 
     size_t size() const {
-        return pages_.size();
+        return (static_cast<size_t>(std::distance(begin_, end_)) + page_size_ - 1) / page_size_;
     }
 
 private:
-    std::vector<IteratorRange<Iterator>> pages_;
+    Iterator begin_;
+    Iterator end_;
+    size_t page_size_;
 };
 
 template <typename Container>
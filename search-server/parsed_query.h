@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+#include "document_scoring.h"
+#include "term_dictionary.h"
+
+// Query parsed by SearchServer::ParseQuery: terms are sorted, unique and resolved to posting lists.
+// Parsing into the same object again reuses its buffers, so once they have grown to fit
+// the longest query no heap allocation happens. The query is valid until the server is modified.
+class ParsedQuery {
+public:
+    // Scratch query of the calling thread
+    static ParsedQuery& ForCurrentThread() {
+        thread_local ParsedQuery query;
+        return query;
+    }
+
+    // Words found in the index and not stop words
+    const std::vector<TermId>& GetPlusTerms() const {
+        return plus_terms_;
+    }
+
+    const std::vector<TermId>& GetMinusTerms() const {
+        return minus_terms_;
+    }
+
+    // Plus terms without live documents are left out
+    const QueryPostings& GetPostings() const {
+        return postings_;
+    }
+
+private:
+    friend class SearchServer;
+
+    // Split words of the last parsed text, they point into it
+    std::vector<std::string_view> words_;
+    std::vector<TermId> plus_terms_;
+    std::vector<TermId> minus_terms_;
+    QueryPostings postings_;
+
+    void Clear() {
+        words_.clear();
+        plus_terms_.clear();
+        minus_terms_.clear();
+        postings_.plus_postings.clear();
+        postings_.minus_postings.clear();
+    }
+};
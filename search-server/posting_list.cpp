@@ -0,0 +1,204 @@
+#include "posting_list.h"
+
+using namespace std;
+
+namespace {
+
+int BitWidth(uint32_t value) {
+    int width = 0;
+    while (value > 0) {
+        ++width;
+        value >>= 1;
+    }
+    return width;
+}
+
+void PackBits(const uint32_t* values, size_t size, int width, vector<uint8_t>& out) {
+    uint64_t buffer = 0;
+    int filled = 0;
+    for (size_t i = 0; i < size; ++i) {
+        buffer |= static_cast<uint64_t>(values[i]) << filled;
+        filled += width;
+        while (filled >= 8) {
+            out.push_back(static_cast<uint8_t>(buffer));
+            buffer >>= 8;
+            filled -= 8;
+        }
+    }
+    if (filled > 0) {
+        out.push_back(static_cast<uint8_t>(buffer));
+    }
+}
+
+// Returns the position right after the packed values
+const uint8_t* UnpackBits(const uint8_t* in, size_t size, int width, uint32_t* values) {
+    const uint64_t mask = (uint64_t{1} << width) - 1;
+    uint64_t buffer = 0;
+    int filled = 0;
+    for (size_t i = 0; i < size; ++i) {
+        while (filled < width) {
+            buffer |= static_cast<uint64_t>(*in++) << filled;
+            filled += 8;
+        }
+        values[i] = static_cast<uint32_t>(buffer & mask);
+        buffer >>= width;
+        filled -= width;
+    }
+    return in;
+}
+
+} // namespace
+
+void PostingList::Add(DocumentOrdinal ordinal, uint32_t count, uint32_t word_count) {
+    // Computed the way scoring computes term freqs, so the max bounds them exactly
+    max_term_freq_ = max(max_term_freq_, count * 1.0 / word_count);
+    tail_.push_back({ordinal, count});
+    ++size_;
+    if (tail_.size() == BLOCK_SIZE) {
+        blocks_.push_back(EncodeBlock(tail_.data(), tail_.size(), data_));
+        tail_.clear();
+    }
+}
+
+size_t PostingList::Erase(const vector<DocumentOrdinal>& ordinals) {
+    size_t erased_count = 0;
+
+    if (!blocks_.empty() && !ordinals.empty() && ordinals.front() <= blocks_.back().last_ordinal) {
+        vector<uint8_t> data;
+        vector<PostingBlock> blocks;
+        data.reserve(data_.size());
+        blocks.reserve(blocks_.size());
+        Posting postings[BLOCK_SIZE];
+        auto ordinal_it = ordinals.begin();
+        for (size_t block_index = 0; block_index < blocks_.size(); ++block_index) {
+            const PostingBlock& block = blocks_[block_index];
+            ordinal_it = lower_bound(ordinal_it, ordinals.end(), block.first_ordinal);
+            if (ordinal_it == ordinals.end() || *ordinal_it > block.last_ordinal) {
+                const size_t end = block_index + 1 < blocks_.size() ? blocks_[block_index + 1].offset : data_.size();
+                PostingBlock moved_block = block;
+                moved_block.offset = data.size();
+                data.insert(data.end(), data_.begin() + block.offset, data_.begin() + end);
+                blocks.push_back(moved_block);
+                continue;
+            }
+
+            const size_t size = View().DecodeBlock(block_index, postings);
+            size_t kept_size = 0;
+            for (size_t i = 0; i < size; ++i) {
+                while (ordinal_it != ordinals.end() && *ordinal_it < postings[i].ordinal) {
+                    ++ordinal_it;
+                }
+                if (ordinal_it != ordinals.end() && *ordinal_it == postings[i].ordinal) {
+                    ++erased_count;
+                } else {
+                    postings[kept_size++] = postings[i];
+                }
+            }
+            if (kept_size > 0) {
+                blocks.push_back(EncodeBlock(postings, kept_size, data));
+            }
+        }
+        data_ = move(data);
+        blocks_ = move(blocks);
+    }
+
+    const auto tail_end = remove_if(tail_.begin(), tail_.end(), [&ordinals](const Posting& posting) {
+        return binary_search(ordinals.begin(), ordinals.end(), posting.ordinal);
+    });
+    erased_count += tail_.end() - tail_end;
+    tail_.erase(tail_end, tail_.end());
+
+    size_ -= erased_count;
+    return erased_count;
+}
+
+void PostingList::ShrinkToFit() {
+    if (!tail_.empty()) {
+        blocks_.push_back(EncodeBlock(tail_.data(), tail_.size(), data_));
+        tail_.clear();
+    }
+    data_.shrink_to_fit();
+    blocks_.shrink_to_fit();
+    tail_.shrink_to_fit();
+}
+
+PostingBlock PostingList::EncodeBlock(const Posting* postings, size_t size, vector<uint8_t>& data) {
+    // Ordinals are strictly increasing, so gaps are stored minus one, counts are at least one
+    uint32_t gaps[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    uint32_t max_gap = 0;
+    uint32_t max_count = 0;
+    for (size_t i = 0; i < size; ++i) {
+        gaps[i] = i == 0 ? 0 : postings[i].ordinal - postings[i - 1].ordinal - 1;
+        counts[i] = postings[i].count - 1;
+        max_gap = max(max_gap, gaps[i]);
+        max_count = max(max_count, counts[i]);
+    }
+
+    PostingBlock block;
+    block.first_ordinal = postings[0].ordinal;
+    block.last_ordinal = postings[size - 1].ordinal;
+    block.offset = data.size();
+    block.size = size;
+    block.gap_width = BitWidth(max_gap);
+    block.count_width = BitWidth(max_count);
+    PackBits(gaps, size, block.gap_width, data);
+    PackBits(counts, size, block.count_width, data);
+    return block;
+}
+
+size_t PostingListView::DecodeBlock(size_t block_index, Posting* postings) const {
+    const PostingBlock& block = blocks_[block_index];
+    uint32_t gaps[PostingList::BLOCK_SIZE];
+    uint32_t counts[PostingList::BLOCK_SIZE];
+    const uint8_t* in = data_ + block.offset;
+    in = UnpackBits(in, block.size, block.gap_width, gaps);
+    UnpackBits(in, block.size, block.count_width, counts);
+
+    DocumentOrdinal ordinal = block.first_ordinal - 1;
+    for (size_t i = 0; i < block.size; ++i) {
+        ordinal += gaps[i] + 1;
+        postings[i] = {ordinal, counts[i] + 1};
+    }
+    return block.size;
+}
+
+bool PostingListView::IsValid(DocumentOrdinal ordinal_count) const {
+    // Every ordinal must be above the previous one, the first one above "-1"
+    int64_t previous_ordinal = -1;
+    size_t posting_count = 0;
+    const auto is_next = [&previous_ordinal, ordinal_count](DocumentOrdinal ordinal) {
+        const bool is_valid = ordinal > previous_ordinal && ordinal < ordinal_count;
+        previous_ordinal = ordinal;
+        return is_valid;
+    };
+
+    Posting postings[PostingList::BLOCK_SIZE];
+    for (size_t i = 0; i < block_count_; ++i) {
+        const PostingBlock& block = blocks_[i];
+        if (block.size == 0 || block.size > PostingList::BLOCK_SIZE || block.gap_width > 32 || block.count_width > 32) {
+            return false;
+        }
+        const size_t packed_size = (block.size * block.gap_width + 7) / 8 + (block.size * block.count_width + 7) / 8;
+        if (block.offset > data_size_ || packed_size > data_size_ - block.offset) {
+            return false;
+        }
+        // Gaps may wrap around, so every decoded ordinal is checked, not only the skip table
+        const size_t size = DecodeBlock(i, postings);
+        if (postings[0].ordinal != block.first_ordinal || postings[size - 1].ordinal != block.last_ordinal) {
+            return false;
+        }
+        for (size_t j = 0; j < size; ++j) {
+            if (!is_next(postings[j].ordinal)) {
+                return false;
+            }
+        }
+        posting_count += size;
+    }
+    for (const Posting* it = tail_; it != tail_ + tail_size_; ++it) {
+        if (!is_next(it->ordinal)) {
+            return false;
+        }
+    }
+    return posting_count + tail_size_ == size_;
+}
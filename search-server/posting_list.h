@@ -0,0 +1,251 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Internal dense number of a document inside SearchServer.
+// Ordinals are handed out in insertion order. Reclaiming slots of purged documents
+// renumbers the documents left, keeping their order.
+using DocumentOrdinal = uint32_t;
+
+struct Posting {
+    DocumentOrdinal ordinal;
+    uint32_t count; // occurrences of the term in the document
+};
+
+// Skip table entry of a compressed block
+struct PostingBlock {
+    DocumentOrdinal first_ordinal;
+    DocumentOrdinal last_ordinal;
+    uint32_t offset; // in the compressed data of the list
+    uint16_t size;
+    uint8_t gap_width;
+    uint8_t count_width;
+};
+
+// Read-only view of a posting list, the storage is owned by a PostingList or a mapped snapshot
+class PostingListView {
+public:
+    PostingListView() = default;
+
+    // max_term_freq bounds term freqs of the documents in the list, 1 if unknown
+    PostingListView(const uint8_t* data, size_t data_size, const PostingBlock* blocks, size_t block_count,
+                    const Posting* tail, size_t tail_size, size_t size, double max_term_freq = 1.0)
+        : data_(data), data_size_(data_size), blocks_(blocks), block_count_(block_count)
+        , tail_(tail), tail_size_(tail_size), size_(size), max_term_freq_(max_term_freq) {
+    }
+
+    // Calls func(ordinal, count) for postings with ordinals in [first, last) in increasing order.
+    // Blocks outside the range are skipped without decoding.
+    template <typename Func>
+    void ForEach(DocumentOrdinal first, DocumentOrdinal last, Func func) const;
+
+    // Calls func(ordinal, count) for postings with the given sorted ordinals in increasing order.
+    // Blocks without any of the ordinals are skipped without decoding.
+    template <typename Func>
+    void ForEachOf(const std::vector<DocumentOrdinal>& ordinals, Func func) const;
+
+    size_t size() const {
+        return size_;
+    }
+
+    double GetMaxTermFreq() const {
+        return max_term_freq_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    const uint8_t* GetData() const {
+        return data_;
+    }
+
+    size_t GetDataSize() const {
+        return data_size_;
+    }
+
+    const PostingBlock* GetBlocks() const {
+        return blocks_;
+    }
+
+    size_t GetBlockCount() const {
+        return block_count_;
+    }
+
+    const Posting* GetTail() const {
+        return tail_;
+    }
+
+    size_t GetTailSize() const {
+        return tail_size_;
+    }
+
+    // Returns the number of decoded postings
+    size_t DecodeBlock(size_t block_index, Posting* postings) const;
+
+    // For views over untrusted storage: checks that every block decodes within the data,
+    // matches its skip table entry and that all ordinals, the tail included, are strictly
+    // increasing and below ordinal_count. Decodes the whole list.
+    bool IsValid(DocumentOrdinal ordinal_count) const;
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t data_size_ = 0;
+    const PostingBlock* blocks_ = nullptr;
+    size_t block_count_ = 0;
+    const Posting* tail_ = nullptr;
+    size_t tail_size_ = 0;
+    size_t size_ = 0;
+    double max_term_freq_ = 1.0;
+};
+
+// Postings of one term sorted by document ordinal and compressed in blocks of BLOCK_SIZE.
+// A block stores gaps between neighbouring ordinals and term counts bit-packed
+// with the smallest width that fits the block, its first and last ordinals
+// are kept uncompressed in a skip table. The newest postings wait in an
+// uncompressed tail until a whole block is collected or the list is shrunk.
+class PostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    // Ordinals must be appended in increasing order, word_count of the document
+    // is only used to keep the max term freq of the list
+    void Add(DocumentOrdinal ordinal, uint32_t count, uint32_t word_count);
+
+    // Erases postings of the ordinals, which must be sorted, in one pass over the list.
+    // Blocks without them are copied without decoding. Returns the number of erased postings.
+    size_t Erase(const std::vector<DocumentOrdinal>& ordinals);
+
+    // Encodes the tail as a short block and releases spare capacity. Meant for lists done growing,
+    // postings added later start a new tail.
+    void ShrinkToFit();
+
+    // Calls func(ordinal, count) for postings with ordinals in [first, last) in increasing order
+    template <typename Func>
+    void ForEach(DocumentOrdinal first, DocumentOrdinal last, Func func) const {
+        View().ForEach(first, last, func);
+    }
+
+    template <typename Func>
+    void ForEach(Func func) const {
+        ForEach(0, MAX_ORDINAL, func);
+    }
+
+    PostingListView View() const {
+        return {data_.data(), data_.size(), blocks_.data(), blocks_.size(), tail_.data(), tail_.size(), size_,
+                max_term_freq_};
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // Max of count / word_count over added postings, erasing postings doesn't lower it
+    double GetMaxTermFreq() const {
+        return max_term_freq_;
+    }
+
+    // Bytes taken by compressed data, skip table and tail
+    size_t GetMemoryUsage() const {
+        return data_.capacity() + blocks_.capacity() * sizeof(PostingBlock) + tail_.capacity() * sizeof(Posting);
+    }
+
+private:
+    static constexpr DocumentOrdinal MAX_ORDINAL = UINT32_MAX;
+
+    std::vector<uint8_t> data_;
+    std::vector<PostingBlock> blocks_;
+    std::vector<Posting> tail_;
+    size_t size_ = 0;
+    double max_term_freq_ = 0.0;
+
+    // Appends the encoded block to data, postings must be non-empty
+    static PostingBlock EncodeBlock(const Posting* postings, size_t size, std::vector<uint8_t>& data);
+};
+
+template <typename Func>
+void PostingListView::ForEach(DocumentOrdinal first, DocumentOrdinal last, Func func) const {
+    const PostingBlock* const blocks_end = blocks_ + block_count_;
+    const PostingBlock* block_it = std::lower_bound(blocks_, blocks_end, first,
+        [](const PostingBlock& block, DocumentOrdinal value) {
+            return block.last_ordinal < value;
+        });
+
+    Posting postings[PostingList::BLOCK_SIZE];
+    for (; block_it != blocks_end && block_it->first_ordinal < last; ++block_it) {
+        const size_t size = DecodeBlock(block_it - blocks_, postings);
+        for (size_t i = 0; i < size; ++i) {
+            if (postings[i].ordinal >= last) {
+                return;
+            }
+            if (postings[i].ordinal >= first) {
+                func(postings[i].ordinal, postings[i].count);
+            }
+        }
+    }
+
+    for (const Posting* it = tail_; it != tail_ + tail_size_; ++it) {
+        const auto [ordinal, count] = *it;
+        if (ordinal >= last) {
+            return;
+        }
+        if (ordinal >= first) {
+            func(ordinal, count);
+        }
+    }
+}
+
+template <typename Func>
+void PostingListView::ForEachOf(const std::vector<DocumentOrdinal>& ordinals, Func func) const {
+    auto ordinal_it = ordinals.begin();
+    const PostingBlock* const blocks_end = blocks_ + block_count_;
+    const PostingBlock* block_it = blocks_;
+
+    Posting postings[PostingList::BLOCK_SIZE];
+    while (ordinal_it != ordinals.end()) {
+        block_it = std::lower_bound(block_it, blocks_end, *ordinal_it,
+            [](const PostingBlock& block, DocumentOrdinal value) {
+                return block.last_ordinal < value;
+            });
+        if (block_it == blocks_end) {
+            break;
+        }
+        ordinal_it = std::lower_bound(ordinal_it, ordinals.end(), block_it->first_ordinal);
+        if (ordinal_it == ordinals.end() || *ordinal_it > block_it->last_ordinal) {
+            continue;
+        }
+
+        // The last posting of a block has its last ordinal, so ordinals left are past the block
+        const size_t size = DecodeBlock(block_it - blocks_, postings);
+        for (size_t i = 0; i < size && ordinal_it != ordinals.end();) {
+            if (postings[i].ordinal < *ordinal_it) {
+                ++i;
+            } else {
+                if (postings[i].ordinal == *ordinal_it) {
+                    func(postings[i].ordinal, postings[i].count);
+                    ++i;
+                }
+                ++ordinal_it;
+            }
+        }
+        ++block_it;
+    }
+
+    for (const Posting* it = tail_; it != tail_ + tail_size_ && ordinal_it != ordinals.end();) {
+        if (it->ordinal < *ordinal_it) {
+            ++it;
+        } else {
+            if (it->ordinal == *ordinal_it) {
+                func(it->ordinal, it->count);
+                ++it;
+            }
+            ++ordinal_it;
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#include "process_queries.h"
+
+using namespace std;
+
+vector<vector<Document>> ProcessQueries(
+        const SearchServer& search_server,
+        const vector<string>& queries) {
+
+    vector<vector<Document>> documents_lists(queries.size());
+    search_server.GetThreadPool().ParallelFor(queries.size(), [&](size_t i) {
+        documents_lists[i] = search_server.FindTopDocuments(queries[i]);
+    });
+    return documents_lists;
+}
+
+vector<Document> ProcessQueriesJoined(
+        const SearchServer& search_server,
+        const vector<string>& queries) {
+
+    const auto documents_lists = ProcessQueries(search_server, queries);
+
+    size_t total_size = 0;
+    for (const auto& documents : documents_lists) {
+        total_size += documents.size();
+    }
+
+    vector<Document> joined_documents;
+    joined_documents.reserve(total_size);
+    for (const auto& documents : documents_lists) {
+        joined_documents.insert(joined_documents.end(), documents.begin(), documents.end());
+    }
+    return joined_documents;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "search_server.h"
+#include "document.h"
+
+// Runs FindTopDocuments for every query in parallel on the server's thread pool.
+// Queries are independent tasks, so each worker reuses its own scoring buffers.
+std::vector<std::vector<Document>> ProcessQueries(
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries);
+
+// Results of ProcessQueries concatenated in query order
+std::vector<Document> ProcessQueriesJoined(
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries);
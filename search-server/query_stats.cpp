@@ -0,0 +1,204 @@
+#include "query_stats.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+uint64_t RoundUpToPowerOfTwo(size_t value) {
+    uint64_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+int64_t FloorDiv(int64_t value, int64_t divisor) {
+    return value / divisor - (value % divisor < 0);
+}
+
+const uint64_t WRITTEN_FLAG = uint64_t{1} << 63;
+const int LAP_SHIFT = 48;
+const uint64_t LAP_MASK = (uint64_t{1} << 15) - 1;
+const uint64_t COUNT_MASK = (uint64_t{1} << LAP_SHIFT) - 1;
+
+// Laps are compared modulo 2^15, a lap less than half of that ahead is newer
+bool IsNewerLap(uint64_t lap, uint64_t other_lap) {
+    const uint64_t difference = (lap - other_lap) & LAP_MASK;
+    return difference != 0 && difference <= LAP_MASK / 2;
+}
+
+} // namespace
+
+size_t GetResultCountBucket(size_t result_count) {
+    size_t bucket = 0;
+    while (result_count > 0 && bucket + 1 < RESULT_COUNT_BUCKETS) {
+        ++bucket;
+        result_count >>= 1;
+    }
+    return bucket;
+}
+
+QueryStatsRecorder::BucketRing::BucketRing(Clock::duration width, size_t size)
+    : width_(width.count())
+    , size_(static_cast<int64_t>(size))
+    , counters_(make_unique<atomic<uint64_t>[]>(size)) {
+}
+
+int64_t QueryStatsRecorder::BucketRing::GetBucket(Clock::rep time) const {
+    return FloorDiv(time, width_);
+}
+
+void QueryStatsRecorder::BucketRing::Add(int64_t bucket) {
+    atomic<uint64_t>& counter = counters_[bucket - FloorDiv(bucket, size_) * size_];
+    const uint64_t lap = static_cast<uint64_t>(FloorDiv(bucket, size_)) & LAP_MASK;
+    uint64_t value = counter.load(memory_order_relaxed);
+    uint64_t new_value;
+    do {
+        const uint64_t value_lap = (value >> LAP_SHIFT) & LAP_MASK;
+        if ((value & WRITTEN_FLAG) == 0 || IsNewerLap(lap, value_lap)) {
+            new_value = WRITTEN_FLAG | (lap << LAP_SHIFT) | 1;
+        } else if (value_lap == lap) {
+            new_value = value + 1;
+        } else {
+            // The bucket counts a later lap already
+            return;
+        }
+    } while (!counter.compare_exchange_weak(value, new_value, memory_order_relaxed));
+}
+
+pair<uint64_t, bool> QueryStatsRecorder::BucketRing::Sum(int64_t first, int64_t last) const {
+    uint64_t sum = 0;
+    bool is_complete = true;
+    for (int64_t bucket = max(first, last - size_ + 1); bucket <= last; ++bucket) {
+        const uint64_t value = counters_[bucket - FloorDiv(bucket, size_) * size_].load(memory_order_relaxed);
+        const uint64_t lap = static_cast<uint64_t>(FloorDiv(bucket, size_)) & LAP_MASK;
+        const uint64_t value_lap = (value >> LAP_SHIFT) & LAP_MASK;
+        if ((value & WRITTEN_FLAG) == 0) {
+            continue;
+        }
+        if (value_lap == lap) {
+            sum += value & COUNT_MASK;
+        } else if (IsNewerLap(value_lap, lap)) {
+            is_complete = false;
+        }
+    }
+    // Buckets more than a ring before last are overwritten by the ring's last lap at the latest
+    if (last - first + 1 > size_) {
+        is_complete = false;
+    }
+    return {sum, is_complete};
+}
+
+QueryStatsRecorder::QueryStatsRecorder(size_t capacity)
+    : slots_(make_unique<Slot[]>(RoundUpToPowerOfTwo(capacity)))
+    , mask_(RoundUpToPowerOfTwo(capacity) - 1)
+    , empty_per_second_(chrono::seconds(1), EMPTY_RESULT_SECOND_BUCKETS)
+    , empty_per_minute_(chrono::minutes(1), EMPTY_RESULT_MINUTE_BUCKETS) {
+}
+
+void QueryStatsRecorder::Record(Clock::time_point finish_time, Clock::duration latency, size_t result_count) {
+    if (result_count == 0) {
+        const Clock::rep time = finish_time.time_since_epoch().count();
+        empty_per_second_.Add(empty_per_second_.GetBucket(time));
+        empty_per_minute_.Add(empty_per_minute_.GetBucket(time));
+    }
+    const uint64_t request = next_request_.fetch_add(1, memory_order_relaxed);
+    Slot& slot = slots_[request & mask_];
+    uint64_t sequence = slot.sequence.load(memory_order_relaxed);
+    do {
+        if (sequence % 2 == 1 || sequence > request * 2) {
+            return;
+        }
+    } while (!slot.sequence.compare_exchange_weak(sequence, request * 2 + 1, memory_order_relaxed));
+    atomic_thread_fence(memory_order_release);
+    slot.finish_time.store(finish_time.time_since_epoch().count(), memory_order_relaxed);
+    slot.latency.store(latency.count(), memory_order_relaxed);
+    slot.result_count.store(static_cast<uint32_t>(min<size_t>(result_count, numeric_limits<uint32_t>::max())),
+                            memory_order_relaxed);
+    slot.sequence.store(request * 2 + 2, memory_order_release);
+}
+
+template <typename Func>
+void QueryStatsRecorder::ForEachRecord(Clock::duration window, Clock::time_point now, Func func) const {
+    const Clock::rep window_start = (now - window).time_since_epoch().count();
+    const Clock::rep window_end = now.time_since_epoch().count();
+
+    for (uint64_t i = 0; i <= mask_; ++i) {
+        const Slot& slot = slots_[i];
+        const uint64_t sequence = slot.sequence.load(memory_order_acquire);
+        if (sequence == 0 || sequence % 2 == 1) {
+            continue;
+        }
+        const Clock::rep finish_time = slot.finish_time.load(memory_order_relaxed);
+        const Clock::rep latency = slot.latency.load(memory_order_relaxed);
+        const uint32_t result_count = slot.result_count.load(memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (slot.sequence.load(memory_order_relaxed) != sequence
+                || finish_time < window_start || finish_time > window_end) {
+            continue;
+        }
+        func(latency, result_count);
+    }
+}
+
+QueryStats QueryStatsRecorder::GetStats(Clock::duration window, Clock::time_point now) const {
+    QueryStats stats;
+    vector<Clock::rep> latencies;
+    ForEachRecord(window, now, [&stats, &latencies](Clock::rep latency, uint32_t result_count) {
+        latencies.push_back(latency);
+        if (result_count == 0) {
+            ++stats.empty_result_count;
+        }
+        ++stats.result_count_histogram[GetResultCountBucket(result_count)];
+    });
+
+    stats.request_count = latencies.size();
+    if (latencies.empty()) {
+        return stats;
+    }
+    stats.empty_result_rate = stats.empty_result_count * 1.0 / stats.request_count;
+
+    // Nearest-rank percentiles, every nth_element works on the part above the previous percentile
+    size_t first = 0;
+    const auto percentile = [&latencies, &first](double fraction) {
+        const size_t rank = min(static_cast<size_t>(fraction * latencies.size()), latencies.size() - 1);
+        nth_element(latencies.begin() + first, latencies.begin() + rank, latencies.end());
+        first = rank;
+        return chrono::duration_cast<chrono::nanoseconds>(Clock::duration(latencies[rank]));
+    };
+    stats.latency_p50 = percentile(0.5);
+    stats.latency_p90 = percentile(0.9);
+    stats.latency_p99 = percentile(0.99);
+    stats.latency_max = chrono::duration_cast<chrono::nanoseconds>(
+            Clock::duration(*max_element(latencies.begin() + first, latencies.end())));
+    return stats;
+}
+
+size_t QueryStatsRecorder::CountEmptyResults(Clock::duration window, Clock::time_point now) const {
+    const Clock::rep window_start = (now - window).time_since_epoch().count();
+    const Clock::rep window_end = now.time_since_epoch().count();
+    if (window_start > window_end) {
+        return 0;
+    }
+    const int64_t seconds_per_minute = 60;
+    const int64_t first_second = empty_per_second_.GetBucket(window_start);
+    const int64_t last_second = empty_per_second_.GetBucket(window_end);
+    const int64_t first_minute = FloorDiv(first_second, seconds_per_minute);
+    const int64_t last_minute = FloorDiv(last_second, seconds_per_minute);
+
+    // The part of the window within a minute is counted by seconds while they are kept
+    const auto count_part = [this](int64_t minute, int64_t first, int64_t last) {
+        const auto [count, is_complete] = empty_per_second_.Sum(first, last);
+        return is_complete ? count : empty_per_minute_.Sum(minute, minute).first;
+    };
+    if (first_minute == last_minute) {
+        return count_part(first_minute, first_second, last_second);
+    }
+    return count_part(first_minute, first_second, (first_minute + 1) * seconds_per_minute - 1)
+        + empty_per_minute_.Sum(first_minute + 1, last_minute - 1).first
+        + count_part(last_minute, last_minute * seconds_per_minute, last_second);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// Requests this many records back are overwritten by new ones
+const size_t DEFAULT_QUERY_STATS_CAPACITY {1 << 16};
+// Empty results are also counted per second for that many seconds (over an hour)
+// and per minute for that many minutes (over a day)
+const size_t EMPTY_RESULT_SECOND_BUCKETS {4096};
+const size_t EMPTY_RESULT_MINUTE_BUCKETS {2048};
+// Result counts are grouped by powers of two: bucket 0 is for no documents found,
+// bucket k for [2^(k-1), 2^k) documents and the last one for all larger counts
+const size_t RESULT_COUNT_BUCKETS {33};
+
+size_t GetResultCountBucket(size_t result_count);
+
+struct QueryStats {
+    size_t request_count = 0;
+    size_t empty_result_count = 0;
+    double empty_result_rate = 0.0;
+    std::chrono::nanoseconds latency_p50 {0};
+    std::chrono::nanoseconds latency_p90 {0};
+    std::chrono::nanoseconds latency_p99 {0};
+    std::chrono::nanoseconds latency_max {0};
+    // Number of requests by GetResultCountBucket of the number of documents found
+    std::array<size_t, RESULT_COUNT_BUCKETS> result_count_histogram {};
+};
+
+// Ring buffer of per-request records, Record is lock-free and may be called from any number of threads.
+// Every slot is a seqlock: readers skip records being written or overwritten while read,
+// so GetStats never blocks writers. A window covers at most the last capacity requests.
+// A writer claims its slot only from an older finished record, so a record is dropped
+// if a writer a whole ring behind is still writing the slot or a newer record already took it.
+// Empty results are counted in time buckets besides, so counting them reads a few buckets
+// instead of every record.
+class QueryStatsRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Capacity is rounded up to a power of two
+    explicit QueryStatsRecorder(size_t capacity = DEFAULT_QUERY_STATS_CAPACITY);
+
+    void Record(Clock::time_point finish_time, Clock::duration latency, size_t result_count);
+
+    // Requests finished within window before now
+    QueryStats GetStats(Clock::duration window, Clock::time_point now = Clock::now()) const;
+
+    // Empty results of requests finished within window before now, counted by whole buckets:
+    // seconds at the edges of the window while they are kept, minutes otherwise.
+    // Unlike GetStats, not limited to the last capacity requests.
+    size_t CountEmptyResults(Clock::duration window, Clock::time_point now = Clock::now()) const;
+
+private:
+    struct Slot {
+        // 0 if never written, odd while written, otherwise 2 * (request index + 1)
+        std::atomic<uint64_t> sequence {0};
+        std::atomic<Clock::rep> finish_time {0};
+        std::atomic<Clock::rep> latency {0};
+        std::atomic<uint32_t> result_count {0};
+    };
+
+    // Ring of counters by time. A counter packs a written flag (bit 63) and the lap of the ring
+    // it counts for (bits 48-62) with the count, the first writer of a newer lap resets it.
+    class BucketRing {
+    public:
+        BucketRing(Clock::duration width, size_t size);
+
+        int64_t GetBucket(Clock::rep time) const;
+
+        void Add(int64_t bucket);
+
+        // Sum of the buckets [first, last] and whether none of them was reused by a later lap yet
+        std::pair<uint64_t, bool> Sum(int64_t first, int64_t last) const;
+
+    private:
+        Clock::rep width_;
+        int64_t size_;
+        std::unique_ptr<std::atomic<uint64_t>[]> counters_;
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    const uint64_t mask_;
+    std::atomic<uint64_t> next_request_ {0};
+    BucketRing empty_per_second_;
+    BucketRing empty_per_minute_;
+
+    // Calls func(latency, result_count) for every record finished within window before now
+    template <typename Func>
+    void ForEachRecord(Clock::duration window, Clock::time_point now, Func func) const;
+};
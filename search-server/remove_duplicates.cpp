@@ -1,25 +1,95 @@
 #include "remove_duplicates.h"
 
-void RemoveDuplicates(SearchServer& search_server) {
-    std::set<std::set<std::string>> unique_words;
-    std::set<int> del_docs;
-    for (int doc_id : search_server) {
-        //make document words sequencies
-        std::set<std::string> doc_words;
-        for(auto& [word, _] : search_server.GetWordFrequencies(doc_id)) {
-            doc_words.insert(word);
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+using namespace std;
+
+namespace {
+
+// 128-bit fingerprint of a sorted term set, equal sets always get equal fingerprints
+struct Fingerprint {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    bool operator==(const Fingerprint& other) const {
+        return low == other.low && high == other.high;
+    }
+};
+
+struct FingerprintHasher {
+    size_t operator()(const Fingerprint& fingerprint) const {
+        return static_cast<size_t>(fingerprint.low);
+    }
+};
+
+// splitmix64 finalizer
+uint64_t Mix(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+
+// Halves are chained with different seeds, so a collision of one rarely repeats in the other
+Fingerprint ComputeFingerprint(const WordFrequenciesView& words) {
+    Fingerprint fingerprint {Mix(words.size()), Mix(words.size() ^ 0x9e3779b97f4a7c15ULL)};
+    const WordFreq* word_freqs = words.GetWordFreqs();
+    for (size_t i = 0; i < words.size(); ++i) {
+        const uint64_t term = word_freqs[i].term;
+        fingerprint.low = Mix(fingerprint.low + term);
+        fingerprint.high = Mix(fingerprint.high ^ (term * 0xc2b2ae3d27d4eb4fULL));
+    }
+    return fingerprint;
+}
+
+bool HaveSameTerms(const WordFrequenciesView& lhs, const WordFrequenciesView& rhs) {
+    return lhs.size() == rhs.size()
+        && equal(lhs.GetWordFreqs(), lhs.GetWordFreqs() + lhs.size(), rhs.GetWordFreqs(),
+                 [](const WordFreq& lhs_word, const WordFreq& rhs_word) {
+                     return lhs_word.term == rhs_word.term;
+                 });
+}
+
+} // namespace
+
+vector<int> RemoveDuplicates(SearchServer& search_server) {
+    const vector<int> document_ids(search_server.begin(), search_server.end());
+    vector<WordFrequenciesView> documents(document_ids.size());
+    vector<Fingerprint> fingerprints(document_ids.size());
+
+    ThreadPool& thread_pool = search_server.GetThreadPool();
+    const size_t task_count = thread_pool.GetTaskCount(document_ids.size(), MIN_DOCUMENTS_PER_TASK);
+    const size_t chunk_size = (document_ids.size() + task_count - 1) / task_count;
+    thread_pool.ParallelFor(task_count, [&](size_t task) {
+        const size_t first = min(task * chunk_size, document_ids.size());
+        const size_t last = min(first + chunk_size, document_ids.size());
+        for (size_t i = first; i < last; ++i) {
+            documents[i] = search_server.GetWordFrequenciesView(document_ids[i]);
+            fingerprints[i] = ComputeFingerprint(documents[i]);
         }
-        if(unique_words.find(doc_words) == unique_words.end()) {
-            //find new unique words sequencies
-            unique_words.insert(doc_words);
+    });
+
+    // Ids are ascending, so the first document of every group is kept.
+    // A fingerprint maps to the kept documents having it, more than one only on a collision.
+    unordered_map<Fingerprint, vector<size_t>, FingerprintHasher> kept_documents;
+    kept_documents.reserve(document_ids.size());
+    vector<int> duplicate_ids;
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        vector<size_t>& same_fingerprint = kept_documents[fingerprints[i]];
+        const bool is_duplicate = any_of(same_fingerprint.begin(), same_fingerprint.end(), [&](size_t kept) {
+            return HaveSameTerms(documents[kept], documents[i]);
+        });
+        if (is_duplicate) {
+            duplicate_ids.push_back(document_ids[i]);
         } else {
-            //find duplicate document
-            del_docs.insert(doc_id);
+            same_fingerprint.push_back(i);
         }
     }
 
-    for(auto doc_id : del_docs) {
-        search_server.RemoveDocument(doc_id);
-        std::cout << "Found duplicate document id " << doc_id << std::endl;
-    }
+    search_server.RemoveDocuments(execution::par, duplicate_ids);
+    return duplicate_ids;
 }
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <vector>
+
 #include "search_server.h"
 
-void RemoveDuplicates(SearchServer& search_server);
+// Removes documents with the same set of words as a document with a smaller id.
+// Returns the removed ids in ascending order.
+std::vector<int> RemoveDuplicates(SearchServer& search_server);
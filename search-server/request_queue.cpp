@@ -2,48 +2,33 @@
 
 using namespace std;
 
-RequestQueue::RequestQueue(const SearchServer& search_server)
-    : search_server_(search_server) {}
-
-// сделаем "обёртки" для всех методов поиска, чтобы сохранять результаты для нашей статистики
-template <typename DocumentPredicate>
-vector<Document> RequestQueue::AddFindRequest(const string& raw_query, DocumentPredicate document_predicate) {
-    vector<Document> docs = search_server_.FindTopDocuments(raw_query, document_predicate);
-    PushFindRequest(docs.empty());
-    return docs;
-}
+RequestQueue::RequestQueue(const SearchServer& search_server, size_t stats_capacity)
+    : search_server_(search_server)
+    , stats_(stats_capacity) {}
 
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query, DocumentStatus status) {
+    const auto start_time = QueryStatsRecorder::Clock::now();
     vector<Document> docs = search_server_.FindTopDocuments(raw_query, status);
-    PushFindRequest(docs.empty());
+    RecordFindRequest(start_time, docs.size());
     return docs;
 }
 
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query) {
-     vector<Document> docs = search_server_.FindTopDocuments(raw_query);
-     PushFindRequest(docs.empty());
-     return docs;
+    const auto start_time = QueryStatsRecorder::Clock::now();
+    vector<Document> docs = search_server_.FindTopDocuments(raw_query);
+    RecordFindRequest(start_time, docs.size());
+    return docs;
 }
 
 int RequestQueue::GetNoResultRequests() const {
-    return requests_.back().count_nores;
+    return static_cast<int>(stats_.CountEmptyResults(chrono::hours(24)));
+}
+
+QueryStats RequestQueue::GetStats(chrono::steady_clock::duration window) const {
+    return stats_.GetStats(window);
 }
 
-void RequestQueue::PushFindRequest(bool nores){
-    if(requests_.empty()) {
-        QueryResult fresh = {nores, 0, 0};
-        nores ? ++fresh.count_nores : ++fresh.count_res;
-        requests_.push_back(fresh);
-        return;
-    }
-    QueryResult last = requests_.back();
-    bool decrease_count = (last.count_res + last.count_nores) >= min_in_day_ ? true : false;
-    QueryResult fresh = {nores, last.count_res, last.count_nores};
-    nores ? ++fresh.count_nores : ++fresh.count_res;
-    if(decrease_count) {
-        QueryResult first = requests_.front();
-        requests_.pop_front();
-        first.nores ? --fresh.count_nores : --fresh.count_res;
-    }
-    requests_.push_back(fresh);
+void RequestQueue::RecordFindRequest(QueryStatsRecorder::Clock::time_point start_time, size_t result_count) {
+    const auto finish_time = QueryStatsRecorder::Clock::now();
+    stats_.Record(finish_time, finish_time - start_time, result_count);
 }
@@ -1,32 +1,39 @@
 #pragma once
 
+#include <chrono>
 #include <string>
 #include <vector>
-#include <deque>
 
+#include "query_stats.h"
 #include "search_server.h"
 
+// Searches the server and records statistics of the requests.
+// AddFindRequest may be called from many threads as long as the server is not modified.
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server);
+    explicit RequestQueue(const SearchServer& search_server, size_t stats_capacity = DEFAULT_QUERY_STATS_CAPACITY);
     // сделаем "обёртки" для всех методов поиска, чтобы сохранять результаты для нашей статистики
     template <typename DocumentPredicate>
-    std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate);
+    std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
+        const auto start_time = QueryStatsRecorder::Clock::now();
+        std::vector<Document> docs = search_server_.FindTopDocuments(raw_query, document_predicate);
+        RecordFindRequest(start_time, docs.size());
+        return docs;
+    }
 
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
 
     std::vector<Document> AddFindRequest(const std::string& raw_query);
 
+    // Requests without results during the last day
     int GetNoResultRequests() const;
+
+    // Requests finished during the last window
+    QueryStats GetStats(std::chrono::steady_clock::duration window) const;
+
 private:
-    struct QueryResult {
-        bool nores = true;
-        int count_res = 0;
-        int count_nores = 0;
-    };
     const SearchServer& search_server_;
-    std::deque<QueryResult> requests_;
-    const static int min_in_day_ = 1440;
+    QueryStatsRecorder stats_;
 
-    void PushFindRequest(bool nores);
+    void RecordFindRequest(QueryStatsRecorder::Clock::time_point start_time, size_t result_count);
 };
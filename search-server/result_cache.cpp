@@ -0,0 +1,117 @@
+#include "result_cache.h"
+
+#include <functional>
+
+using namespace std;
+
+size_t ResultCacheKeyHasher::operator()(const ResultCacheKey& key) const {
+    uint64_t hash = static_cast<uint64_t>(key.status) * 31 + key.max_result_count;
+    for (const TermId term : key.plus_terms) {
+        hash = hash * 0x9e3779b97f4a7c15ULL + term;
+    }
+    // Separates plus terms from minus ones
+    hash = hash * 0x9e3779b97f4a7c15ULL + key.plus_terms.size();
+    for (const TermId term : key.minus_terms) {
+        hash = hash * 0x9e3779b97f4a7c15ULL + term;
+    }
+    return static_cast<size_t>(hash ^ (hash >> 32));
+}
+
+ResultCache::ResultCache(size_t capacity) {
+    SetCapacity(capacity);
+}
+
+ResultCache::ResultCache(const ResultCache& other)
+    : ResultCache(other.capacity_per_shard_ * RESULT_CACHE_SHARD_COUNT) {
+}
+
+ResultCache& ResultCache::operator=(const ResultCache& other) {
+    if (this != &other) {
+        SetCapacity(other.capacity_per_shard_ * RESULT_CACHE_SHARD_COUNT);
+    }
+    return *this;
+}
+
+void ResultCache::SetCapacity(size_t capacity) {
+    capacity_per_shard_ = (capacity + RESULT_CACHE_SHARD_COUNT - 1) / RESULT_CACHE_SHARD_COUNT;
+    shards_ = make_unique<Shard[]>(RESULT_CACHE_SHARD_COUNT);
+}
+
+optional<vector<Document>> ResultCache::Find(const ResultCacheKey& key) const {
+    if (!IsEnabled()) {
+        return nullopt;
+    }
+    const size_t hash = ResultCacheKeyHasher()(key);
+    Shard& shard = GetShard(hash);
+    lock_guard lock(shard.mutex);
+    const auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        ++shard.stats.miss_count;
+        return nullopt;
+    }
+    if (it->second->generation != generation_) {
+        ++shard.stats.miss_count;
+        ++shard.stats.invalidation_count;
+        Erase(shard, it->second);
+        return nullopt;
+    }
+    ++shard.stats.hit_count;
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    return it->second->documents;
+}
+
+void ResultCache::Insert(ResultCacheKey key, const vector<Document>& documents) const {
+    if (!IsEnabled()) {
+        return;
+    }
+    const size_t hash = ResultCacheKeyHasher()(key);
+    Shard& shard = GetShard(hash);
+    lock_guard lock(shard.mutex);
+    // Another thread may have inserted the same query meanwhile
+    if (const auto it = shard.index.find(key); it != shard.index.end()) {
+        Erase(shard, it->second);
+    }
+    if (shard.entries.size() == capacity_per_shard_) {
+        ++shard.stats.eviction_count;
+        Erase(shard, prev(shard.entries.end()));
+    }
+    shard.entries.push_front({move(key), documents, generation_});
+    shard.index.emplace(shard.entries.front().key, shard.entries.begin());
+    ++shard.stats.entry_count;
+    shard.stats.memory_bytes += GetMemoryBytes(shard.entries.front());
+}
+
+ResultCacheStats ResultCache::GetStats() const {
+    ResultCacheStats stats;
+    if (!shards_) {
+        return stats;
+    }
+    for (size_t i = 0; i < RESULT_CACHE_SHARD_COUNT; ++i) {
+        Shard& shard = shards_[i];
+        lock_guard lock(shard.mutex);
+        stats.hit_count += shard.stats.hit_count;
+        stats.miss_count += shard.stats.miss_count;
+        stats.eviction_count += shard.stats.eviction_count;
+        stats.invalidation_count += shard.stats.invalidation_count;
+        stats.entry_count += shard.stats.entry_count;
+        stats.memory_bytes += shard.stats.memory_bytes;
+    }
+    return stats;
+}
+
+size_t ResultCache::GetMemoryBytes(const Entry& entry) {
+    // The key is stored twice, in the list entry and in the index
+    const size_t key_bytes = sizeof(ResultCacheKey)
+        + (entry.key.plus_terms.capacity() + entry.key.minus_terms.capacity()) * sizeof(TermId);
+    // List node links, index node with its bucket and cached hash
+    const size_t node_bytes = 2 * sizeof(void*) + 3 * sizeof(void*) + sizeof(list<Entry>::iterator);
+    return 2 * key_bytes + node_bytes + sizeof(Entry) - sizeof(ResultCacheKey)
+        + entry.documents.capacity() * sizeof(Document);
+}
+
+void ResultCache::Erase(Shard& shard, list<Entry>::iterator it) {
+    --shard.stats.entry_count;
+    shard.stats.memory_bytes -= GetMemoryBytes(*it);
+    shard.index.erase(it->key);
+    shard.entries.erase(it);
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+#include "term_dictionary.h"
+
+const size_t RESULT_CACHE_SHARD_COUNT {16};
+
+// Normalized query, terms are sorted and unique
+struct ResultCacheKey {
+    std::vector<TermId> plus_terms;
+    std::vector<TermId> minus_terms;
+    DocumentStatus status;
+    size_t max_result_count;
+
+    bool operator==(const ResultCacheKey& other) const {
+        return status == other.status && max_result_count == other.max_result_count
+            && plus_terms == other.plus_terms && minus_terms == other.minus_terms;
+    }
+};
+
+struct ResultCacheKeyHasher {
+    size_t operator()(const ResultCacheKey& key) const;
+};
+
+struct ResultCacheStats {
+    uint64_t hit_count = 0;
+    uint64_t miss_count = 0;
+    // Least recently used entries dropped for new ones
+    uint64_t eviction_count = 0;
+    // Entries found stale after the index changed
+    uint64_t invalidation_count = 0;
+    size_t entry_count = 0;
+    // Approximate memory held by the entries
+    size_t memory_bytes = 0;
+
+    double GetHitRate() const {
+        const uint64_t lookup_count = hit_count + miss_count;
+        return lookup_count == 0 ? 0.0 : hit_count * 1.0 / lookup_count;
+    }
+};
+
+// Search results by normalized query, split into shards with an LRU list and a mutex each.
+// Find and Insert may run concurrently. The owner calls Invalidate whenever the index changes,
+// entries of older generations are dropped lazily when found.
+// A copy starts empty with the same capacity.
+class ResultCache {
+public:
+    // Disabled unless a capacity is given
+    explicit ResultCache(size_t capacity = 0);
+
+    ResultCache(const ResultCache& other);
+    ResultCache& operator=(const ResultCache& other);
+    ResultCache(ResultCache&&) = default;
+    ResultCache& operator=(ResultCache&&) = default;
+
+    // Drops all entries and statistics, 0 disables the cache. Must not run concurrently with lookups.
+    void SetCapacity(size_t capacity);
+
+    bool IsEnabled() const {
+        return capacity_per_shard_ > 0;
+    }
+
+    void Invalidate() {
+        ++generation_;
+    }
+
+    std::optional<std::vector<Document>> Find(const ResultCacheKey& key) const;
+
+    void Insert(ResultCacheKey key, const std::vector<Document>& documents) const;
+
+    ResultCacheStats GetStats() const;
+
+private:
+    struct Entry {
+        ResultCacheKey key;
+        std::vector<Document> documents;
+        uint64_t generation;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        // Most recently used first
+        std::list<Entry> entries;
+        std::unordered_map<ResultCacheKey, std::list<Entry>::iterator, ResultCacheKeyHasher> index;
+        ResultCacheStats stats;
+    };
+
+    size_t capacity_per_shard_ = 0;
+    std::unique_ptr<Shard[]> shards_;
+    uint64_t generation_ = 0;
+
+    Shard& GetShard(size_t hash) const {
+        return shards_[hash % RESULT_CACHE_SHARD_COUNT];
+    }
+
+    static size_t GetMemoryBytes(const Entry& entry);
+
+    // Shard must be locked
+    static void Erase(Shard& shard, std::list<Entry>::iterator it);
+};
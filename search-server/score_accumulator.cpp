@@ -0,0 +1,76 @@
+#include "score_accumulator.h"
+
+using namespace std;
+
+ScoringScratch& ScoringScratch::ForCurrentThread() {
+    thread_local ScoringScratch scratch;
+    return scratch;
+}
+
+void ScoreAccumulator::Reset(DocumentOrdinal first, DocumentOrdinal last) {
+    for (const DocumentOrdinal ordinal : touched_) {
+        ClearBit(touched_bits_, ordinal);
+    }
+    for (const DocumentOrdinal ordinal : excluded_) {
+        ClearBit(excluded_bits_, ordinal);
+    }
+    touched_.clear();
+    excluded_.clear();
+
+    first_ = first;
+    const size_t size = last - first;
+    if (scores_.size() < size) {
+        scores_.resize(size);
+        touched_bits_.resize((size + 63) / 64);
+        excluded_bits_.resize((size + 63) / 64);
+    }
+}
+
+void TopScoreHeap::Reset(DocumentOrdinal first, DocumentOrdinal last, size_t max_count) {
+    for (const Entry& entry : entries_) {
+        if (entry.ordinal != NO_ORDINAL) {
+            positions_[entry.ordinal - first_] = NO_POSITION;
+        }
+    }
+    entries_.clear();
+
+    first_ = first;
+    max_count_ = max_count;
+    const size_t size = last - first;
+    if (positions_.size() < size) {
+        positions_.resize(size, NO_POSITION);
+    }
+}
+
+void TopScoreHeap::SiftUp(size_t position) {
+    const Entry entry = entries_[position];
+    while (position > 0) {
+        const size_t parent = (position - 1) / 2;
+        if (entries_[parent].score <= entry.score) {
+            break;
+        }
+        Place(position, entries_[parent]);
+        position = parent;
+    }
+    Place(position, entry);
+}
+
+void TopScoreHeap::SiftDown(size_t position) {
+    const Entry entry = entries_[position];
+    const size_t size = entries_.size();
+    while (true) {
+        size_t child = position * 2 + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && entries_[child + 1].score < entries_[child].score) {
+            ++child;
+        }
+        if (entry.score <= entries_[child].score) {
+            break;
+        }
+        Place(position, entries_[child]);
+        position = child;
+    }
+    Place(position, entry);
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "posting_list.h"
+
+// Dense relevance accumulator over a range of document ordinals.
+// Storage is kept between queries; only touched slots are cleared on Reset.
+class ScoreAccumulator {
+public:
+    // Prepares the accumulator for ordinals in [first, last)
+    void Reset(DocumentOrdinal first, DocumentOrdinal last);
+
+    bool IsExcluded(DocumentOrdinal ordinal) const {
+        const size_t index = ordinal - first_;
+        return (excluded_bits_[index / 64] >> (index % 64)) & 1;
+    }
+
+    // Excluded documents are skipped by Add and ForEach
+    void Exclude(DocumentOrdinal ordinal) {
+        const size_t index = ordinal - first_;
+        excluded_bits_[index / 64] |= uint64_t{1} << (index % 64);
+        excluded_.push_back(ordinal);
+    }
+
+    void Add(DocumentOrdinal ordinal, double relevance) {
+        const size_t index = ordinal - first_;
+        uint64_t& word = touched_bits_[index / 64];
+        const uint64_t bit = uint64_t{1} << (index % 64);
+        if (word & bit) {
+            scores_[index] += relevance;
+        } else {
+            word |= bit;
+            scores_[index] = relevance;
+            touched_.push_back(ordinal);
+        }
+    }
+
+    // The document must have been scored since Reset
+    double GetScore(DocumentOrdinal ordinal) const {
+        return scores_[ordinal - first_];
+    }
+
+    // Calls func(ordinal, relevance) for every scored and not excluded document
+    template <typename Func>
+    void ForEach(Func func) const {
+        for (const DocumentOrdinal ordinal : touched_) {
+            if (!IsExcluded(ordinal)) {
+                func(ordinal, scores_[ordinal - first_]);
+            }
+        }
+    }
+
+private:
+    DocumentOrdinal first_ = 0;
+    std::vector<double> scores_;
+    std::vector<uint64_t> touched_bits_;
+    std::vector<uint64_t> excluded_bits_;
+    std::vector<DocumentOrdinal> touched_;
+    std::vector<DocumentOrdinal> excluded_;
+
+    void ClearBit(std::vector<uint64_t>& bits, DocumentOrdinal ordinal) {
+        const size_t index = ordinal - first_;
+        bits[index / 64] &= ~(uint64_t{1} << (index % 64));
+    }
+};
+
+// Min-heap of the best max_count scores with one entry per document, so once it is full
+// its top bounds the max_count-th best relevance from below. Scores only grow while a query
+// is scored, a document already in the heap has its entry raised in place.
+// Like ScoreAccumulator it covers a range of ordinals and keeps its storage between queries.
+class TopScoreHeap {
+public:
+    void Reset(DocumentOrdinal first, DocumentOrdinal last, size_t max_count);
+
+    // The score of a document must not be lower than the one it was last updated with
+    void Update(DocumentOrdinal ordinal, double score) {
+        uint32_t& position = positions_[ordinal - first_];
+        if (position != NO_POSITION) {
+            entries_[position].score = score;
+            SiftDown(position);
+        } else if (entries_.size() < max_count_) {
+            entries_.push_back({score, ordinal});
+            position = entries_.size() - 1;
+            SiftUp(entries_.size() - 1);
+        } else if (score > entries_.front().score) {
+            ReplaceTop({score, ordinal});
+        }
+    }
+
+    // Score of a document outside the range, it is never updated
+    void AddExternal(double score) {
+        if (entries_.size() < max_count_) {
+            entries_.push_back({score, NO_ORDINAL});
+            SiftUp(entries_.size() - 1);
+        } else if (score > entries_.front().score) {
+            ReplaceTop({score, NO_ORDINAL});
+        }
+    }
+
+    bool IsFull() const {
+        return entries_.size() == max_count_;
+    }
+
+    double GetMin() const {
+        return entries_.front().score;
+    }
+
+private:
+    static constexpr uint32_t NO_POSITION = UINT32_MAX;
+    static constexpr DocumentOrdinal NO_ORDINAL = UINT32_MAX;
+
+    struct Entry {
+        double score;
+        DocumentOrdinal ordinal;
+    };
+
+    DocumentOrdinal first_ = 0;
+    size_t max_count_ = 0;
+    std::vector<Entry> entries_;
+    // Indexed by ordinal - first_, NO_POSITION for documents outside the heap
+    std::vector<uint32_t> positions_;
+
+    void Place(size_t position, const Entry& entry) {
+        entries_[position] = entry;
+        if (entry.ordinal != NO_ORDINAL) {
+            positions_[entry.ordinal - first_] = position;
+        }
+    }
+
+    void ReplaceTop(const Entry& entry) {
+        if (entries_.front().ordinal != NO_ORDINAL) {
+            positions_[entries_.front().ordinal - first_] = NO_POSITION;
+        }
+        Place(0, entry);
+        SiftDown(0);
+    }
+
+    void SiftUp(size_t position);
+    void SiftDown(size_t position);
+};
+
+// Buffers of ScoreDocumentRange reserved for the calling thread. Once they have grown
+// to fit the largest query and ordinal range, scoring doesn't allocate.
+struct ScoringScratch {
+    static ScoringScratch& ForCurrentThread();
+
+    ScoreAccumulator document_to_relevance;
+    TopScoreHeap top_scores;
+    std::vector<size_t> word_order;
+    std::vector<double> remaining_bounds;
+    std::vector<size_t> remaining_posting_counts;
+    std::vector<DocumentOrdinal> candidates;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <execution>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+
+// One page of ranked search results
+struct SearchPage {
+    std::vector<Document> documents;
+    bool has_next_page = false;
+};
+
+// Returns page page_index (from 0) of the results of the query ranked by IsMoreRelevant.
+// Scoring keeps only the (page_index + 1) * page_size + 1 best documents in its bounded heap
+// instead of scoring all of them into a sorted list, and the extra document tells whether
+// there is a next page. Ties are ranked by id, so consecutive pages neither overlap nor skip.
+// Works with any server providing FindTopDocuments(policy, query, document_predicate, max_result_count),
+// document_predicate may be a DocumentStatus as well.
+// Throws std::invalid_argument if page_size is 0, as such pages never end,
+// and std::out_of_range if the page ends too far for the max result count to fit in size_t.
+template <typename Server, typename ExecutionPolicy, typename DocumentPredicate>
+SearchPage FindTopDocumentsPage(
+        const Server& search_server, ExecutionPolicy&& policy,
+        const std::string_view raw_query, DocumentPredicate document_predicate,
+        size_t page_index, size_t page_size) {
+    using namespace std::literals;
+
+    if (page_size == 0) {
+        throw std::invalid_argument("Page size must be positive"s);
+    }
+    // offset + page_size + 1 must not overflow
+    const size_t max_page_end = std::numeric_limits<size_t>::max() - 1;
+    if (page_size > max_page_end || page_index > (max_page_end - page_size) / page_size) {
+        throw std::out_of_range("Page is out of range"s);
+    }
+    const size_t offset = page_index * page_size;
+    std::vector<Document> documents = search_server.FindTopDocuments(
+            policy, raw_query, document_predicate, offset + page_size + 1);
+
+    SearchPage page;
+    if (documents.size() > offset + page_size) {
+        page.has_next_page = true;
+        documents.pop_back();
+    }
+    if (documents.size() > offset) {
+        page.documents.assign(documents.begin() + offset, documents.end());
+    }
+    return page;
+}
+
+template <typename Server, typename DocumentPredicate>
+SearchPage FindTopDocumentsPage(
+        const Server& search_server,
+        const std::string_view raw_query, DocumentPredicate document_predicate,
+        size_t page_index, size_t page_size) {
+    return FindTopDocumentsPage(search_server, std::execution::seq, raw_query, document_predicate,
+                                page_index, page_size);
+}
+
+template <typename Server>
+SearchPage FindTopDocumentsPage(
+        const Server& search_server, const std::string_view raw_query,
+        size_t page_index, size_t page_size) {
+    return FindTopDocumentsPage(search_server, std::execution::seq, raw_query, DocumentStatus::ACTUAL,
+                                page_index, page_size);
+}
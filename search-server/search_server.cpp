@@ -1,165 +1,434 @@
 #include <algorithm>
 #include <cmath>
+#include <limits>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
 #include "search_server.h"
 #include "string_processing.h"
 
 using namespace std;
 
-void SearchServer::AddDocument(int document_id, const string_view data,
+void SearchServer::AddDocument(int document_id, const string_view document,
                                DocumentStatus status, const vector<int>& ratings) {
 
-    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+    if ((document_id < 0) || (document_ids_.count(document_id) > 0)) {
         throw invalid_argument("Invalid document_id"s);
     }
 
-    const auto& [it, _] = documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status, static_cast<std::string>(data)});
-    const string& document = it->second.data;
-
-    const auto words = SplitIntoWordsNoStop(document);
-
-    const double inv_word_count = 1.0 / words.size();
-    for (const auto word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        document_to_word_freqs_[document_id][word] += inv_word_count;
+    auto terms = SplitIntoTermsNoStop(document);
+    word_to_document_freqs_.resize(terms_.size());
+
+    const DocumentOrdinal ordinal = documents_.size();
+    vector<WordFreq> word_freqs;
+
+    // Equal terms are adjacent after sorting, each run becomes one WordFreq
+    const double inv_word_count = 1.0 / terms.size();
+    sort(terms.begin(), terms.end());
+    for (auto it = terms.begin(); it != terms.end();) {
+        const auto run_end = upper_bound(it, terms.end(), *it);
+        const double term_freq = (run_end - it) * inv_word_count;
+        word_freqs.push_back({*it, term_freq});
+        word_to_document_freqs_[*it].Add(ordinal, run_end - it, terms.size());
+        it = run_end;
     }
 
+    documents_.push_back({document_id, ComputeAverageRating(ratings), status, static_cast<uint32_t>(terms.size())});
+    status_index_.Add(ordinal, status);
+    document_to_word_freqs_.push_back(move(word_freqs));
+    document_ordinals_.emplace(document_id, ordinal);
     document_ids_.insert(document_id);
+    inverse_document_freqs_.StartEpoch(terms_.size());
+    result_cache_.Invalidate();
 }
 
-int SearchServer::GetDocumentCount() const {
-    return documents_.size();
-}
+void SearchServer::AddDocuments(const vector<RawDocument>& documents) {
+    // Ids are checked before the text, like AddDocument does
+    size_t first_invalid_id = documents.size();
+    {
+        unordered_set<int> batch_ids;
+        for (size_t i = 0; i < documents.size(); ++i) {
+            const int document_id = documents[i].id;
+            if (document_id < 0 || document_ids_.count(document_id) > 0 || !batch_ids.insert(document_id).second) {
+                first_invalid_id = i;
+                break;
+            }
+        }
+    }
 
-tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(
-        const execution::sequenced_policy&,
-        const string_view raw_query, int document_id) const {
+    // Terms of a chunk are numbered locally first, so tokenizing needs no shared state
+    static const uint32_t LOCAL_STOP_TERM = UINT32_MAX;
+    struct ParsedDocument {
+        vector<pair<uint32_t, uint32_t>> term_counts; // local, then global term with its count
+        uint32_t word_count = 0;
+        size_t invalid_word_index = 0;
+        vector<string_view> words;
+    };
+    struct Chunk {
+        size_t first = 0;
+        size_t last = 0;
+        unordered_map<string_view, uint32_t> local_terms;
+        vector<string_view> local_term_words;
+        vector<TermId> global_terms;
+        vector<tuple<TermId, DocumentOrdinal, uint32_t>> postings;
+    };
+
+    const size_t chunk_count = thread_pool_->GetTaskCount(documents.size(), MIN_DOCUMENTS_PER_TASK);
+    const size_t chunk_size = (documents.size() + chunk_count - 1) / chunk_count;
+    vector<Chunk> chunks(chunk_count);
+    vector<ParsedDocument> parsed_documents(documents.size());
+
+    thread_pool_->ParallelFor(chunk_count, [&](size_t c) {
+        Chunk& chunk = chunks[c];
+        chunk.first = min(c * chunk_size, documents.size());
+        chunk.last = min(chunk.first + chunk_size, documents.size());
+        vector<uint32_t> terms;
+        for (size_t i = chunk.first; i < chunk.last; ++i) {
+            ParsedDocument& parsed = parsed_documents[i];
+            parsed.invalid_word_index = SplitIntoValidWords(documents[i].text, parsed.words);
+            if (parsed.invalid_word_index < parsed.words.size()) {
+                continue;
+            }
+            terms.clear();
+            for (const auto word : parsed.words) {
+                auto [it, inserted] = chunk.local_terms.emplace(word, chunk.local_term_words.size());
+                if (inserted) {
+                    const auto term = terms_.Find(word);
+                    if (term && IsStopTerm(*term)) {
+                        it->second = LOCAL_STOP_TERM;
+                    } else {
+                        chunk.local_term_words.push_back(word);
+                    }
+                }
+                if (it->second != LOCAL_STOP_TERM) {
+                    terms.push_back(it->second);
+                }
+            }
+            parsed.word_count = terms.size();
+            sort(terms.begin(), terms.end());
+            for (auto it = terms.begin(); it != terms.end();) {
+                const auto run_end = upper_bound(it, terms.end(), *it);
+                parsed.term_counts.push_back({*it, static_cast<uint32_t>(run_end - it)});
+                it = run_end;
+            }
+        }
+    });
 
-    if (document_ids_.count(document_id) == 0) {
-        throw out_of_range("wrong id");
+    size_t first_invalid_word = documents.size();
+    for (size_t i = 0; i < documents.size(); ++i) {
+        if (parsed_documents[i].invalid_word_index < parsed_documents[i].words.size()) {
+            first_invalid_word = i;
+            break;
+        }
+    }
+    if (first_invalid_id < documents.size() && first_invalid_id <= first_invalid_word) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    if (first_invalid_word < documents.size()) {
+        const auto& parsed = parsed_documents[first_invalid_word];
+        throw invalid_argument("Word "s + static_cast<std::string>(parsed.words[parsed.invalid_word_index]) + " is invalid"s);
     }
 
-    vector<string_view> matched_words;
+    // Merging local dictionaries is the only sequential pass over terms
+    for (Chunk& chunk : chunks) {
+        chunk.global_terms.reserve(chunk.local_term_words.size());
+        for (const auto word : chunk.local_term_words) {
+            chunk.global_terms.push_back(terms_.Intern(word));
+        }
+    }
+    word_to_document_freqs_.resize(terms_.size());
+
+    const DocumentOrdinal first_ordinal = documents_.size();
+    vector<vector<WordFreq>> new_word_freqs(documents.size());
+    thread_pool_->ParallelFor(chunk_count, [&](size_t c) {
+        Chunk& chunk = chunks[c];
+        for (size_t i = chunk.first; i < chunk.last; ++i) {
+            ParsedDocument& parsed = parsed_documents[i];
+            for (auto& [term, _] : parsed.term_counts) {
+                term = chunk.global_terms[term];
+            }
+            sort(parsed.term_counts.begin(), parsed.term_counts.end());
 
-    auto words_freqs = GetWordFrequencies(document_id);
+            const double inv_word_count = 1.0 / parsed.word_count;
+            for (const auto& [term, count] : parsed.term_counts) {
+                new_word_freqs[i].push_back({term, count * inv_word_count});
+                chunk.postings.emplace_back(term, first_ordinal + i, count);
+            }
+        }
+        sort(chunk.postings.begin(), chunk.postings.end());
+    });
+
+    // Each task owns a range of terms and appends their postings chunk by chunk,
+    // chunks follow in ordinal order, so posting lists stay sorted
+    size_t posting_count = 0;
+    for (const Chunk& chunk : chunks) {
+        posting_count += chunk.postings.size();
+    }
+    const size_t term_count = terms_.size();
+    const size_t task_count = thread_pool_->GetTaskCount(posting_count, MIN_POSTINGS_PER_TASK);
+    const size_t term_range_size = (term_count + task_count - 1) / task_count;
+    thread_pool_->ParallelFor(task_count, [&](size_t task) {
+        const TermId first_term = min(task * term_range_size, term_count);
+        const TermId last_term = min(first_term + term_range_size, term_count);
+        for (const Chunk& chunk : chunks) {
+            auto it = lower_bound(chunk.postings.begin(), chunk.postings.end(),
+                                  make_tuple(first_term, DocumentOrdinal{0}, uint32_t{0}));
+            for (; it != chunk.postings.end() && get<0>(*it) < last_term; ++it) {
+                const auto [term, ordinal, count] = *it;
+                word_to_document_freqs_[term].Add(ordinal, count, parsed_documents[ordinal - first_ordinal].word_count);
+            }
+        }
+    });
+
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const RawDocument& document = documents[i];
+        documents_.push_back({document.id, ComputeAverageRating(document.ratings), document.status,
+                              parsed_documents[i].word_count});
+        status_index_.Add(first_ordinal + i, document.status);
+        document_to_word_freqs_.push_back(move(new_word_freqs[i]));
+        document_ordinals_.emplace(document.id, first_ordinal + i);
+        document_ids_.insert(document.id);
+    }
+    inverse_document_freqs_.StartEpoch(terms_.size());
+    result_cache_.Invalidate();
+}
 
-    if (words_freqs.empty()) {
-        return {matched_words, documents_.at(document_id).status};
+void SearchServer::MergeFrom(const SearchServer& other) {
+    for (const int document_id : other.document_ids_) {
+        if (document_ids_.count(document_id) > 0) {
+            throw invalid_argument("Invalid document_id"s);
+        }
     }
 
-    const auto query = ParseQuery(raw_query);
+    // Only terms having documents are carried over, stop words of both servers are the same
+    vector<TermId> term_ids(other.terms_.size(), NO_TERM);
+    for (TermId term = 0; term < other.terms_.size(); ++term) {
+        if (other.GetDocumentFreq(term) > 0) {
+            term_ids[term] = terms_.Intern(other.terms_.GetTerm(term));
+        }
+    }
+    word_to_document_freqs_.resize(terms_.size());
+
+    // Documents keep their order, so new ordinals of a term's postings keep increasing.
+    // Postings of documents removed from other are not carried over.
+    const DocumentOrdinal no_ordinal = numeric_limits<DocumentOrdinal>::max();
+    vector<DocumentOrdinal> ordinals(other.documents_.size(), no_ordinal);
+    for (DocumentOrdinal other_ordinal = 0; other_ordinal < other.documents_.size(); ++other_ordinal) {
+        const DocumentData& document_data = other.documents_[other_ordinal];
+        const auto it = other.document_ordinals_.find(document_data.id);
+        if (it == other.document_ordinals_.end() || it->second != other_ordinal) {
+            continue;
+        }
+        const DocumentOrdinal ordinal = documents_.size();
+        ordinals[other_ordinal] = ordinal;
 
-    for (const auto& word_freqs : words_freqs) {
-        if (find(query.minus_words.begin(),
-                 query.minus_words.end(),
-                 word_freqs.first) != query.minus_words.end()) {
-            return {matched_words, documents_.at(document_id).status};
+        vector<WordFreq> word_freqs;
+        word_freqs.reserve(other.document_to_word_freqs_[other_ordinal].size());
+        for (const auto [term, term_freq] : other.document_to_word_freqs_[other_ordinal]) {
+            word_freqs.push_back({term_ids[term], term_freq});
         }
+        sort(word_freqs.begin(), word_freqs.end(), [](const WordFreq& lhs, const WordFreq& rhs) {
+            return lhs.term < rhs.term;
+        });
+
+        documents_.push_back(document_data);
+        status_index_.Add(ordinal, document_data.status);
+        document_to_word_freqs_.push_back(move(word_freqs));
+        document_ordinals_.emplace(document_data.id, ordinal);
+        document_ids_.insert(document_data.id);
     }
 
-    for (const auto& word_freqs : words_freqs) {
-        if (find(query.plus_words.begin(),
-                 query.plus_words.end(),
-                 word_freqs.first) != query.plus_words.end()) {
-            matched_words.push_back(word_freqs.first);
+    for (TermId term = 0; term < other.terms_.size(); ++term) {
+        if (term_ids[term] == NO_TERM) {
+            continue;
         }
+        PostingList& postings = word_to_document_freqs_[term_ids[term]];
+        other.word_to_document_freqs_[term].ForEach([&](DocumentOrdinal other_ordinal, uint32_t count) {
+            if (ordinals[other_ordinal] != no_ordinal) {
+                postings.Add(ordinals[other_ordinal], count, other.documents_[other_ordinal].word_count);
+            }
+        });
     }
+    inverse_document_freqs_.StartEpoch(terms_.size());
+    result_cache_.Invalidate();
+}
+
+void SearchServer::SetResultCacheCapacity(size_t capacity) {
+    result_cache_.SetCapacity(capacity);
+}
+
+void SearchServer::SetThreadPool(shared_ptr<ThreadPool> thread_pool) {
+    thread_pool_ = move(thread_pool);
+}
+
+int SearchServer::GetDocumentCount() const {
+    return document_ids_.size();
+}
 
-    return {matched_words, documents_.at(document_id).status};
+size_t SearchServer::GetIndexMemoryUsage() const {
+    size_t memory_usage = 0;
+    for (const PostingList& postings : word_to_document_freqs_) {
+        memory_usage += postings.GetMemoryUsage();
+    }
+    return memory_usage;
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(
-        const execution::parallel_policy&,
+        const execution::sequenced_policy&,
         const string_view raw_query, int document_id) const {
 
     if (document_ids_.count(document_id) == 0) {
         throw out_of_range("wrong id");
     }
 
-    vector<string_view> matched_words;
-
-    auto words_freqs = GetWordFrequencies(document_id);
-
-    if (words_freqs.empty()) {
-        return {matched_words, documents_.at(document_id).status};
+    const DocumentOrdinal ordinal = document_ordinals_.at(document_id);
+    const DocumentStatus status = documents_[ordinal].status;
+    if (document_to_word_freqs_[ordinal].empty()) {
+        return {vector<string_view>(), status};
     }
 
-    const auto query = ParseQuery(raw_query);
+    ParsedQuery& query = ParsedQuery::ForCurrentThread();
+    ParseQuery(raw_query, query);
+    return {MatchQuery(query, ordinal), status};
+}
 
-    for (const auto& word_freqs : words_freqs) {
-        if (find(query.minus_words.begin(),
-                query.minus_words.end(),
-                word_freqs.first) != query.minus_words.end()) {
-            return {matched_words, documents_.at(document_id).status};
-        }
+vector<tuple<vector<string_view>, DocumentStatus>> SearchServer::MatchDocuments(
+        const execution::sequenced_policy&,
+        const string_view raw_query, const vector<int>& document_ids) const {
+
+    const vector<DocumentOrdinal> ordinals = GetOrdinals(document_ids);
+    ParsedQuery& query = ParsedQuery::ForCurrentThread();
+    ParseQuery(raw_query, query);
+    vector<tuple<vector<string_view>, DocumentStatus>> results;
+    results.reserve(ordinals.size());
+    for (const DocumentOrdinal ordinal : ordinals) {
+        results.emplace_back(MatchQuery(query, ordinal), documents_[ordinal].status);
     }
+    return results;
+}
 
-    matched_words.reserve(query.plus_words.size());
-    for_each(words_freqs.begin(), words_freqs.end(),
-            [&query, &matched_words](auto& word_freqs) {
-                if (find(query.plus_words.begin(),
-                        query.plus_words.end(),
-                        word_freqs.first) != query.plus_words.end()) {
-                    matched_words.push_back(word_freqs.first);
-                }
-            }
-    );
-
-    return {matched_words, documents_.at(document_id).status};
+vector<tuple<vector<string_view>, DocumentStatus>> SearchServer::MatchDocuments(
+        const execution::parallel_policy&,
+        const string_view raw_query, const vector<int>& document_ids) const {
+
+    const vector<DocumentOrdinal> ordinals = GetOrdinals(document_ids);
+    ParsedQuery& query = ParsedQuery::ForCurrentThread();
+    ParseQuery(raw_query, query);
+    vector<tuple<vector<string_view>, DocumentStatus>> results(ordinals.size());
+
+    const size_t task_count = thread_pool_->GetTaskCount(ordinals.size(), MIN_DOCUMENTS_PER_TASK);
+    const size_t chunk_size = (ordinals.size() + task_count - 1) / task_count;
+    thread_pool_->ParallelFor(task_count, [&](size_t task) {
+        const size_t first = min(task * chunk_size, ordinals.size());
+        const size_t last = min(first + chunk_size, ordinals.size());
+        for (size_t i = first; i < last; ++i) {
+            results[i] = {MatchQuery(query, ordinals[i]), documents_[ordinals[i]].status};
+        }
+    });
+    return results;
 }
 
-bool SearchServer::IsStopWord(const string_view word) const {
-    return stop_words_.count(word) > 0;
+vector<string_view> SearchServer::MatchQuery(const ParsedQuery& query, DocumentOrdinal ordinal) const {
+    const vector<WordFreq>& word_freqs = document_to_word_freqs_[ordinal];
+    vector<string_view> matched_words;
+    const bool is_matched = MatchSortedTerms(word_freqs.data(), word_freqs.data() + word_freqs.size(),
+        query.GetPlusTerms(), query.GetMinusTerms(), [this, &matched_words](const WordFreq& word_freq) {
+            matched_words.push_back(terms_.GetTerm(word_freq.term));
+        });
+    if (!is_matched) {
+        return {};
+    }
+    // Term ids follow the order of interning, not of the words
+    sort(matched_words.begin(), matched_words.end());
+    return matched_words;
 }
 
-vector<string_view> SearchServer::SplitIntoWordsNoStop(const string_view text) const {
-    vector<string_view> words;
-    for (const auto word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            throw invalid_argument("Word "s + static_cast<std::string>(word) + " is invalid"s);
-        }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
+vector<DocumentOrdinal> SearchServer::GetOrdinals(const vector<int>& document_ids) const {
+    vector<DocumentOrdinal> ordinals;
+    ordinals.reserve(document_ids.size());
+    for (const int document_id : document_ids) {
+        const auto it = document_ordinals_.find(document_id);
+        if (it == document_ordinals_.end()) {
+            throw out_of_range("wrong id");
         }
+        ordinals.push_back(it->second);
     }
-    return words;
+    return ordinals;
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(const string_view text) const {
-    if (text.empty()) {
-        throw invalid_argument("Query word is empty"s);
-    }
-    auto word = text;
-    bool is_minus = false;
-    if (word[0] == '-') {
-        is_minus = true;
-        word = word.substr(1);
+vector<TermId> SearchServer::SplitIntoTermsNoStop(const string_view text) {
+    vector<string_view> words;
+    const size_t invalid_word_index = SplitIntoValidWords(text, words);
+    if (invalid_word_index < words.size()) {
+        throw invalid_argument("Word "s + static_cast<std::string>(words[invalid_word_index]) + " is invalid"s);
     }
-    if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
-        throw invalid_argument("Query word "s + static_cast<std::string>(text) + " is invalid");
+    vector<TermId> terms;
+    terms.reserve(words.size());
+    for (const auto word : words) {
+        const TermId term = terms_.Intern(word);
+        if (!IsStopTerm(term)) {
+            terms.push_back(term);
+        }
     }
+    return terms;
+}
 
-    return {word, is_minus, IsStopWord(word)};
+SearchServer::QueryWord SearchServer::ParseQueryWord(const string_view text, bool is_valid) const {
+    const auto [word, is_minus] = ParseQueryWordText(text, is_valid);
+    const auto term = terms_.Find(word);
+    return {word, term, is_minus, term && IsStopTerm(*term)};
 }
 
-SearchServer::Query SearchServer::ParseQuery(const string_view text) const {
-    Query result;
-    for (const auto word : SplitIntoWords(text)) {
-        const auto query_word = SearchServer::ParseQueryWord(word);
-        if (!query_word.is_stop) {
+void SearchServer::ParseQuery(const string_view raw_query, ParsedQuery& query) const {
+    query.Clear();
+    const size_t invalid_word_index = SplitIntoValidWords(raw_query, query.words_);
+    for (size_t i = 0; i < query.words_.size(); ++i) {
+        const auto query_word = ParseQueryWord(query.words_[i], i != invalid_word_index);
+        if (query_word.term && !query_word.is_stop) {
             if (query_word.is_minus) {
-                result.minus_words.push_back(query_word.data);
+                query.minus_terms_.push_back(*query_word.term);
             } else {
-                result.plus_words.push_back(query_word.data);
+                query.plus_terms_.push_back(*query_word.term);
             }
         }
     }
+    // Repeated words are scored once
+    SortUniqueTerms(query.plus_terms_);
+    SortUniqueTerms(query.minus_terms_);
+
+    QueryPostings& postings = query.postings_;
+    for (const TermId term : query.plus_terms_) {
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(term);
+        if (!isinf(inverse_document_freq)) {
+            postings.plus_postings.push_back({word_to_document_freqs_[term].View(), inverse_document_freq});
+        }
+    }
+    for (const TermId term : query.minus_terms_) {
+        postings.minus_postings.push_back(word_to_document_freqs_[term].View());
+    }
+    if (!postings.plus_postings.empty() && !removed_documents_.empty()) {
+        postings.minus_postings.push_back(GetRemovedDocuments());
+    }
+}
 
-    return result;
+double SearchServer::ComputeWordInverseDocumentFreq(TermId term) const {
+    return inverse_document_freqs_.Get(term, [this, term] {
+        const size_t document_freq = GetDocumentFreq(term);
+        if (document_freq == 0) {
+            return numeric_limits<double>::infinity();
+        }
+        return log(GetDocumentCount() * 1.0 / document_freq);
+    });
 }
 
-// Existence required
-double SearchServer::ComputeWordInverseDocumentFreq(const string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+const ResultCacheKey& SearchServer::MakeResultCacheKey(const ParsedQuery& query, DocumentStatus status,
+                                                       size_t max_result_count) const {
+    thread_local ResultCacheKey key;
+    key.plus_terms.assign(query.GetPlusTerms().begin(), query.GetPlusTerms().end());
+    key.minus_terms.assign(query.GetMinusTerms().begin(), query.GetMinusTerms().end());
+    key.status = status;
+    key.max_result_count = max_result_count;
+    return key;
 }
 
 std::set<int>::iterator SearchServer::begin() const {
@@ -171,20 +440,23 @@ std::set<int>::iterator SearchServer::end() const {
 }
 
 const std::map<std::string_view, double> SearchServer::GetWordFrequencies(int document_id) const {
-    return document_to_word_freqs_.at(document_id);
+    const WordFrequenciesView word_freqs = GetWordFrequenciesView(document_id);
+    return {word_freqs.begin(), word_freqs.end()};
 }
 
-void SearchServer::RemoveDocument(int document_id) {
-    auto it = document_ids_.find(document_id);
-    if (it == document_ids_.end()) {return;}
-    document_ids_.erase(it);
-    documents_.erase(document_id);
-
-    for(auto& [word, _] : document_to_word_freqs_.at(document_id)) {
-        word_to_document_freqs_.at(word).erase(document_id);
+WordFrequenciesView SearchServer::GetWordFrequenciesView(int document_id) const {
+    const auto it = document_ordinals_.find(document_id);
+    if (it == document_ordinals_.end()) {
+        return {};
     }
+    const vector<WordFreq>& word_freqs = document_to_word_freqs_[it->second];
+    return {word_freqs.data(), word_freqs.data() + word_freqs.size(), &terms_};
+}
 
-    document_to_word_freqs_.erase(document_id);
+void SearchServer::RemoveDocument(int document_id) {
+    if (MarkRemoved(document_id) && removed_documents_.size() > MAX_PENDING_REMOVED_DOCUMENTS) {
+        PurgeRemovedDocuments();
+    }
 }
 
 void SearchServer::RemoveDocument(const std::execution::sequenced_policy& policy, int document_id) {
@@ -192,23 +464,219 @@ void SearchServer::RemoveDocument(const std::execution::sequenced_policy& policy
 }
 
 void SearchServer::RemoveDocument(const std::execution::parallel_policy& policy, int document_id) {
+    if (MarkRemoved(document_id) && removed_documents_.size() > MAX_PENDING_REMOVED_DOCUMENTS) {
+        PurgeRemovedDocuments(policy);
+    }
+}
+
+void SearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    if (MarkRemoved(document_ids)) {
+        PurgeRemovedDocuments();
+    }
+}
+
+void SearchServer::RemoveDocuments(const std::execution::parallel_policy& policy, const vector<int>& document_ids) {
+    if (MarkRemoved(document_ids)) {
+        PurgeRemovedDocuments(policy);
+    }
+}
+
+bool SearchServer::MarkRemoved(int document_id) {
+    const auto ordinal = DetachDocument(document_id);
+    if (!ordinal) {
+        return false;
+    }
+    const auto position = upper_bound(removed_documents_.begin(), removed_documents_.end(), *ordinal,
+        [](DocumentOrdinal value, const Posting& posting) {
+            return value < posting.ordinal;
+        });
+    removed_documents_.insert(position, {*ordinal, 1});
+    inverse_document_freqs_.StartEpoch(terms_.size());
+    result_cache_.Invalidate();
+    return true;
+}
+
+bool SearchServer::MarkRemoved(const vector<int>& document_ids) {
+    const size_t removed_count = removed_documents_.size();
+    for (const int document_id : document_ids) {
+        if (const auto ordinal = DetachDocument(document_id)) {
+            removed_documents_.push_back({*ordinal, 1});
+        }
+    }
+    if (removed_documents_.size() == removed_count) {
+        return false;
+    }
+    // One sort instead of a sorted insert per document
+    sort(removed_documents_.begin(), removed_documents_.end(), [](const Posting& lhs, const Posting& rhs) {
+        return lhs.ordinal < rhs.ordinal;
+    });
+    inverse_document_freqs_.StartEpoch(terms_.size());
+    result_cache_.Invalidate();
+    return true;
+}
+
+optional<DocumentOrdinal> SearchServer::DetachDocument(int document_id) {
     auto it = document_ids_.find(document_id);
-    if (it == document_ids_.end()) {return;}
+    if (it == document_ids_.end()) {
+        return nullopt;
+    }
+    const DocumentOrdinal ordinal = document_ordinals_.at(document_id);
+
+    for (const auto [term, _] : document_to_word_freqs_[ordinal]) {
+        ++removed_document_freqs_[term];
+    }
+    document_ordinals_.erase(document_id);
     document_ids_.erase(it);
-    documents_.erase(document_id);
-
-    std::vector<std::string_view> vec_doc_words(document_to_word_freqs_.at(document_id).size());
-    std::transform(std::execution::par_unseq,
-                   document_to_word_freqs_.at(document_id).begin(),
-                   document_to_word_freqs_.at(document_id).end(),
-                   vec_doc_words.begin(), [](auto& word_freq){
-                        return word_freq.first;
-                    });
-
-    std::for_each(std::execution::par_unseq, vec_doc_words.begin(), vec_doc_words.end(),
-                    [=, &document_id](auto word){
-                        word_to_document_freqs_.at(word).erase(document_id);
-                    });
-
-    document_to_word_freqs_.erase(document_id);
+    return ordinal;
+}
+
+void SearchServer::ShrinkToFit() {
+    for (PostingList& postings : word_to_document_freqs_) {
+        postings.ShrinkToFit();
+    }
+}
+
+void SearchServer::PurgeRemovedDocuments() {
+    PurgeRemovedDocuments(1);
+}
+
+void SearchServer::PurgeRemovedDocuments(const std::execution::parallel_policy&) {
+    PurgeRemovedDocuments(thread_pool_->GetTaskCount(removed_document_freqs_.size(), MIN_WORDS_PER_TASK));
+}
+
+void SearchServer::PurgeRemovedDocuments(size_t task_count) {
+    if (removed_documents_.empty()) {
+        return;
+    }
+
+    // Grouped by term, ordinals of a term are sorted
+    vector<pair<TermId, DocumentOrdinal>> removed_postings;
+    for (const Posting& removed : removed_documents_) {
+        for (const auto [term, _] : document_to_word_freqs_[removed.ordinal]) {
+            removed_postings.push_back({term, removed.ordinal});
+        }
+    }
+    sort(removed_postings.begin(), removed_postings.end());
+    vector<size_t> term_starts;
+    for (size_t i = 0; i < removed_postings.size(); ++i) {
+        if (i == 0 || removed_postings[i].first != removed_postings[i - 1].first) {
+            term_starts.push_back(i);
+        }
+    }
+    term_starts.push_back(removed_postings.size());
+
+    // Every term owns its own posting list, so the lists are purged in parallel
+    const size_t term_count = term_starts.size() - 1;
+    task_count = min(task_count, max<size_t>(term_count, 1));
+    const size_t chunk_size = (term_count + task_count - 1) / task_count;
+    vector<size_t> emptied_counts(task_count);
+    thread_pool_->ParallelFor(task_count, [&](size_t task) {
+        const size_t first = min(task * chunk_size, term_count);
+        const size_t last = min(first + chunk_size, term_count);
+        vector<DocumentOrdinal> ordinals;
+        for (size_t i = first; i < last; ++i) {
+            ordinals.clear();
+            for (size_t j = term_starts[i]; j < term_starts[i + 1]; ++j) {
+                ordinals.push_back(removed_postings[j].second);
+            }
+            auto& postings = word_to_document_freqs_[removed_postings[term_starts[i]].first];
+            postings.Erase(ordinals);
+            if (postings.empty()) {
+                ++emptied_counts[task];
+            }
+        }
+    });
+    for (const size_t emptied_count : emptied_counts) {
+        empty_term_count_ += emptied_count;
+    }
+
+    for (const Posting& removed : removed_documents_) {
+        document_to_word_freqs_[removed.ordinal] = {};
+    }
+    removed_documents_.clear();
+    removed_document_freqs_.clear();
+    CompactTermsIfNeeded();
+    CompactDocumentsIfNeeded(task_count);
+}
+
+void SearchServer::CompactTermsIfNeeded() {
+    const size_t term_count = terms_.size() - stop_word_count_;
+    if (empty_term_count_ < MIN_EMPTY_TERMS_TO_COMPACT || empty_term_count_ * 2 < term_count) {
+        return;
+    }
+    empty_term_count_ = count_if(word_to_document_freqs_.begin() + stop_word_count_, word_to_document_freqs_.end(),
+        [](const PostingList& postings) {
+            return postings.empty();
+        });
+    // Compacting only a quarter of the terms away keeps the cost of recounting amortized
+    if (empty_term_count_ * 4 < term_count) {
+        return;
+    }
+
+    // Stop words are always kept and the order of ids is preserved,
+    // so stop words keep their ids and the forward index stays sorted
+    const vector<TermId> new_ids = terms_.Compact([this](TermId term) {
+        return IsStopTerm(term) || !word_to_document_freqs_[term].empty();
+    });
+    vector<PostingList> word_to_document_freqs(terms_.size());
+    for (TermId term = 0; term < new_ids.size(); ++term) {
+        if (new_ids[term] != NO_TERM) {
+            word_to_document_freqs[new_ids[term]] = move(word_to_document_freqs_[term]);
+        }
+    }
+    word_to_document_freqs_ = move(word_to_document_freqs);
+    for (auto& word_freqs : document_to_word_freqs_) {
+        for (auto& word_freq : word_freqs) {
+            word_freq.term = new_ids[word_freq.term];
+        }
+    }
+    empty_term_count_ = 0;
+    inverse_document_freqs_.StartEpoch(terms_.size());
+    result_cache_.Invalidate();
+}
+
+void SearchServer::CompactDocumentsIfNeeded(size_t task_count) {
+    const size_t purged_count = documents_.size() - document_ordinals_.size();
+    if (purged_count < MIN_PURGED_DOCUMENTS_TO_COMPACT || purged_count * 2 < documents_.size()) {
+        return;
+    }
+
+    // Live documents keep their order, so postings stay sorted by the new ordinals
+    const DocumentOrdinal no_ordinal = numeric_limits<DocumentOrdinal>::max();
+    vector<DocumentOrdinal> new_ordinals(documents_.size(), no_ordinal);
+    vector<DocumentData> documents;
+    vector<vector<WordFreq>> document_to_word_freqs;
+    documents.reserve(document_ordinals_.size());
+    document_to_word_freqs.reserve(document_ordinals_.size());
+    StatusIndex status_index;
+    for (DocumentOrdinal ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+        const auto it = document_ordinals_.find(documents_[ordinal].id);
+        if (it == document_ordinals_.end() || it->second != ordinal) {
+            continue;
+        }
+        it->second = new_ordinals[ordinal] = documents.size();
+        status_index.Add(documents.size(), documents_[ordinal].status);
+        documents.push_back(documents_[ordinal]);
+        document_to_word_freqs.push_back(move(document_to_word_freqs_[ordinal]));
+    }
+
+    // Every term owns its own posting list, so the lists are rebuilt in parallel
+    const size_t term_count = word_to_document_freqs_.size();
+    task_count = min(task_count, max<size_t>(term_count, 1));
+    const size_t chunk_size = (term_count + task_count - 1) / task_count;
+    thread_pool_->ParallelFor(task_count, [&](size_t task) {
+        const TermId first = min(task * chunk_size, term_count);
+        const TermId last = min(first + chunk_size, term_count);
+        for (TermId term = first; term < last; ++term) {
+            PostingList postings;
+            word_to_document_freqs_[term].ForEach([&](DocumentOrdinal ordinal, uint32_t count) {
+                postings.Add(new_ordinals[ordinal], count, documents_[ordinal].word_count);
+            });
+            word_to_document_freqs_[term] = move(postings);
+        }
+    });
+
+    documents_ = move(documents);
+    document_to_word_freqs_ = move(document_to_word_freqs);
+    status_index_ = move(status_index);
 }
@@ -7,14 +7,43 @@
 #include <map>
 #include <stdexcept>
 #include <execution>
-#include <future>
+#include <memory>
+#include <optional>
+#include <unordered_map>
 
 #include "string_processing.h"
 #include "document.h"
-#include "concurrent_map.h"
+#include "document_filter.h"
+#include "document_scoring.h"
+#include "idf_cache.h"
+#include "parsed_query.h"
+#include "posting_list.h"
+#include "result_cache.h"
+#include "term_dictionary.h"
+#include "thread_pool.h"
+#include "top_documents.h"
+#include "word_frequencies.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT {5};
-const double MAX_DELTA_RELEVANCE {1e-6};
+// Minimal amount of work worth a separate task of the thread pool
+const size_t MIN_WORDS_PER_TASK {256};
+const size_t MIN_DOCUMENTS_PER_TASK {64};
+// Terms left without documents are dropped from the dictionary once there are
+// at least that many of them and they make up half of the dictionary
+const size_t MIN_EMPTY_TERMS_TO_COMPACT {1024};
+// RemoveDocument purges removed documents once more of them are waiting
+const size_t MAX_PENDING_REMOVED_DOCUMENTS {4096};
+// Slots of purged documents are reclaimed by renumbering the documents once there are
+// at least that many of them and they make up half of the slots
+const size_t MIN_PURGED_DOCUMENTS_TO_COMPACT {4096};
+
+// Document for the batch SearchServer::AddDocuments, text must stay alive during the call only
+struct RawDocument {
+    int id;
+    std::string_view text;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
 
 class SearchServer {
 public:
@@ -31,26 +60,51 @@ public:
 
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+    // Adds the documents in the given order tokenizing them in parallel.
+    // Throws the same exception as the first failing AddDocument call would,
+    // in that case no document of the batch is added.
+    void AddDocuments(const std::vector<RawDocument>& documents);
+
+    // Adds all documents of other with their ids, statuses, ratings and word frequencies,
+    // removed documents of other are not carried over. Both servers must have the same stop words.
+    // Throws std::invalid_argument if an id of other is already in this server.
+    void MergeFrom(const SearchServer& other);
+
+    // All parallel operations run on this pool, ThreadPool::GetDefault() is used initially
+    void SetThreadPool(std::shared_ptr<ThreadPool> thread_pool);
+
+    ThreadPool& GetThreadPool() const {
+        return *thread_pool_;
+    }
+
+    // The result cache is off until a capacity is set: a hit skips scoring, which changes
+    // the latency callers and benchmarks see. Drops cached results, 0 disables the cache.
+    void SetResultCacheCapacity(size_t capacity);
+
+    ResultCacheStats GetResultCacheStats() const {
+        return result_cache_.GetStats();
+    }
+
+    // max_result_count limits the size of the result, only that many documents are kept while scoring
     template <typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(
             ExecutionPolicy&& policy,
-            const std::string_view raw_query, DocumentPredicate document_predicate) const;
+            const std::string_view raw_query, DocumentPredicate document_predicate,
+            size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(
-            const std::string_view raw_query, DocumentPredicate document_predicate) const {
-        return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+            const std::string_view raw_query, DocumentPredicate document_predicate,
+            size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const {
+        return FindTopDocuments(std::execution::seq, raw_query, document_predicate, max_result_count);
     }
 
+    // Results by status are cached until the index changes if the result cache is enabled
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(
             ExecutionPolicy&& policy,
-            const std::string_view raw_query, DocumentStatus status) const {
-        return FindTopDocuments(policy, raw_query,
-            [status](int document_id, DocumentStatus document_status, int rating) {
-                return document_status == status;
-            });
-    }
+            const std::string_view raw_query, DocumentStatus status,
+            size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(
@@ -59,53 +113,140 @@ public:
     }
 
     std::vector<Document> FindTopDocuments(
-            std::string_view raw_query, DocumentStatus status) const {
-        return FindTopDocuments(std::execution::seq, raw_query, status);
+            std::string_view raw_query, DocumentStatus status,
+            size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const {
+        return FindTopDocuments(std::execution::seq, raw_query, status, max_result_count);
     }
 
     std::vector<Document> FindTopDocuments(const std::string_view raw_query) const {
         return FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
     }
 
+    // Parses raw_query into query reusing its buffers, see ParsedQuery.
+    // Throws std::invalid_argument if a word is invalid.
+    void ParseQuery(const std::string_view raw_query, ParsedQuery& query) const;
+
+    // Searches a query parsed by this server since it was last modified
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(
+            ExecutionPolicy&& policy,
+            const ParsedQuery& query, DocumentPredicate document_predicate,
+            size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(
+            ExecutionPolicy&& policy,
+            const ParsedQuery& query, DocumentStatus status,
+            size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
     int GetDocumentCount() const;
 
+    // Bytes taken by the compressed posting lists
+    size_t GetIndexMemoryUsage() const;
+
+    // Matched words point into the server and stay valid until removed documents are purged
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
             const std::execution::sequenced_policy&,
             const std::string_view raw_query, int document_id) const;
 
+    // Matching a single document takes O(query words * log(document words)),
+    // which is too little to split, so it runs sequentially
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
             const std::execution::parallel_policy&,
-            const std::string_view raw_query, int document_id) const;
+            const std::string_view raw_query, int document_id) const {
+        return MatchDocument(std::execution::seq, raw_query, document_id);
+    }
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
             const std::string_view raw_query, int document_id) const {
         return MatchDocument(std::execution::seq, raw_query, document_id);
     }
 
+    // Matches the query parsed once against every document, results follow document_ids.
+    // Throws std::out_of_range if any of the documents is missing.
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(
+            const std::execution::sequenced_policy&,
+            const std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(
+            const std::execution::parallel_policy&,
+            const std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(
+            const std::string_view raw_query, const std::vector<int>& document_ids) const {
+        return MatchDocuments(std::execution::seq, raw_query, document_ids);
+    }
+
     std::set<int>::iterator begin() const;
     std::set<int>::iterator end() const;
 
+    // Copies the words of the document, empty for a missing document
     const std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
 
+    // Same words without copying, empty for a missing document.
+    // The view is valid until the server is modified.
+    WordFrequenciesView GetWordFrequenciesView(int document_id) const;
+
+    // Removes the document from search results at once, its postings are erased
+    // later in bulk by PurgeRemovedDocuments. The parallel version purges in parallel.
     void RemoveDocument(int document_id);
 
     void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
 
     void RemoveDocument(const std::execution::parallel_policy&, int document_id);
 
+    // Removes the documents and purges their postings at once, missing ids are skipped
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    void RemoveDocuments(const std::execution::parallel_policy&, const std::vector<int>& document_ids);
+
+    // Erases postings of removed documents and drops terms left without documents.
+    // Once enough slots of purged documents pile up, the rest are renumbered to reclaim them,
+    // so memory follows the number of live documents rather than of all documents ever added.
+    void PurgeRemovedDocuments();
+
+    void PurgeRemovedDocuments(const std::execution::parallel_policy&);
+
+    // Compresses the uncompressed tails of posting lists and releases their spare capacity,
+    // for a server done growing. Documents added later go to new tails.
+    void ShrinkToFit();
+
+    // Writes the index to a binary snapshot which MappedSearchServer can serve.
+    // The file is replaced atomically, throws std::runtime_error if it can't be written
+    // and leaves no temporary file behind.
+    void SaveSnapshot(const std::string& path) const;
+
 private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-        std::string data;
-    };
-    const std::set<std::string_view, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, DocumentData> documents_;
+    // Reads postings and document data of its segments directly
+    friend class SegmentedSearchServer;
+    // Stop words are interned first, so they take ids [0, stop_word_count_)
+    TermDictionary terms_;
+    TermId stop_word_count_ = 0;
+    // Indexed by TermId
+    std::vector<PostingList> word_to_document_freqs_;
+    std::vector<DocumentData> documents_;
+    // Indexed by DocumentOrdinal like documents_
+    StatusIndex status_index_;
+    // Indexed by DocumentOrdinal, words of a document are sorted by TermId
+    std::vector<std::vector<WordFreq>> document_to_word_freqs_;
+    std::map<int, DocumentOrdinal> document_ordinals_;
     std::set<int> document_ids_;
-    std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
-
-    bool IsStopWord(const std::string_view word) const;
+    // Removed documents waiting for the purge sorted by ordinal, they are kept as
+    // postings so that scoring excludes them the way it excludes minus words
+    std::vector<Posting> removed_documents_;
+    // Number of documents in removed_documents_ containing a term
+    std::unordered_map<TermId, uint32_t> removed_document_freqs_;
+    // Indexed by TermId, a new epoch starts whenever documents are added or removed
+    IdfCache inverse_document_freqs_;
+    // Invalidated together with inverse_document_freqs_
+    ResultCache result_cache_;
+    // Upper bound of non-stop terms with empty posting lists, a term may get documents again
+    size_t empty_term_count_ = 0;
+    std::shared_ptr<ThreadPool> thread_pool_ = ThreadPool::GetDefault();
+
+    bool IsStopTerm(TermId term) const {
+        return term < stop_word_count_;
+    }
 
     static bool IsValidWord(const std::string_view word) {
            // A valid word must not contain special characters
@@ -114,7 +255,37 @@ private:
            });
     }
 
-    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view text) const;
+    // Validates all words of the text before interning them
+    std::vector<TermId> SplitIntoTermsNoStop(const std::string_view text);
+
+    // Number of documents containing the term, removed ones are not counted
+    size_t GetDocumentFreq(TermId term) const {
+        const auto it = removed_document_freqs_.find(term);
+        return word_to_document_freqs_[term].size() - (it == removed_document_freqs_.end() ? 0 : it->second);
+    }
+
+    PostingListView GetRemovedDocuments() const {
+        return {nullptr, 0, nullptr, 0, removed_documents_.data(), removed_documents_.size(), removed_documents_.size()};
+    }
+
+    // Returns false if there is no such document
+    bool MarkRemoved(int document_id);
+
+    // Counts the terms of the document as removed and forgets its id,
+    // the caller adds the ordinal to removed_documents_
+    std::optional<DocumentOrdinal> DetachDocument(int document_id);
+
+    // Returns false if none of the documents exist
+    bool MarkRemoved(const std::vector<int>& document_ids);
+
+    void PurgeRemovedDocuments(size_t task_count);
+
+    // Drops terms without documents if there are enough of them
+    void CompactTermsIfNeeded();
+
+    // Renumbers live documents keeping their order if enough slots are left by purged ones,
+    // posting lists are rebuilt by task_count tasks
+    void CompactDocumentsIfNeeded(size_t task_count);
 
     static int ComputeAverageRating(const std::vector<int>& ratings) {
         if (ratings.empty()) {
@@ -129,205 +300,141 @@ private:
 
     struct QueryWord {
         std::string_view data;
+        std::optional<TermId> term; // empty for words missing in the index
         bool is_minus;
         bool is_stop;
     };
 
-    QueryWord ParseQueryWord(const std::string_view text) const;
+    // is_valid is false for the word SplitIntoValidWords reports as invalid
+    QueryWord ParseQueryWord(const std::string_view text, bool is_valid) const;
 
-    struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
-    };
+    std::vector<std::string_view> MatchQuery(const ParsedQuery& query, DocumentOrdinal ordinal) const;
+
+    std::vector<DocumentOrdinal> GetOrdinals(const std::vector<int>& document_ids) const;
 
-    Query ParseQuery(const std::string_view text) const;
+    // Infinity for terms without documents
+    double ComputeWordInverseDocumentFreq(TermId term) const;
 
-    // Existence required
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    // The key is reused by the calling thread, so that cache hits don't allocate
+    const ResultCacheKey& MakeResultCacheKey(const ParsedQuery& query, DocumentStatus status,
+                                             size_t max_result_count) const;
 
+    // Feeds every matched document into top_documents
     template <typename DocumentPredicate> // CODE
-    std::vector<Document> FindAllDocuments(
+    void FindAllDocuments(
             const std::execution::sequenced_policy&,
-            const Query& query, DocumentPredicate document_predicate) const;
+            const ParsedQuery& query, DocumentPredicate document_predicate,
+            TopDocumentsCollector& top_documents) const;
 
     template <typename DocumentPredicate> // CODE
-    std::vector<Document> FindAllDocuments(
+    void FindAllDocuments(
             const std::execution::parallel_policy&,
-            const Query& query, DocumentPredicate document_predicate) const;
+            const ParsedQuery& query, DocumentPredicate document_predicate,
+            TopDocumentsCollector& top_documents) const;
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(
-            const Query& query, DocumentPredicate document_predicate) const {
-        return FindAllDocuments(std::execution::seq, query, document_predicate);
+    void FindAllDocuments(
+            const ParsedQuery& query, DocumentPredicate document_predicate,
+            TopDocumentsCollector& top_documents) const {
+        FindAllDocuments(std::execution::seq, query, document_predicate, top_documents);
     }
 };
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words))  // Extract non-empty stop words
-{
-    if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
+SearchServer::SearchServer(const StringContainer& stop_words) {
+    const auto unique_stop_words = MakeUniqueNonEmptyStrings(stop_words);  // Extract non-empty stop words
+    if (!all_of(unique_stop_words.begin(), unique_stop_words.end(), IsValidWord)) {
         const char* s = "Some of stop words are invalid";
         throw std::invalid_argument(s);
     }
+    for (const auto word : unique_stop_words) {
+        terms_.Intern(word);
+    }
+    stop_word_count_ = terms_.size();
+    word_to_document_freqs_.resize(terms_.size());
+    inverse_document_freqs_.StartEpoch(terms_.size());
 }
 
 template <typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(
         ExecutionPolicy&& policy,
-        const std::string_view raw_query, DocumentPredicate document_predicate) const {
+        const std::string_view raw_query, DocumentPredicate document_predicate,
+        size_t max_result_count) const {
 
-    const auto query = ParseQuery(raw_query);
-
-    std::vector<Document> matched_documents;
-
-    // SEQ policy
-    if constexpr (std::is_same_v<decltype(policy), decltype(std::execution::seq)&>) {
-
-        matched_documents = FindAllDocuments(std::execution::seq, query, document_predicate);
+    ParsedQuery& query = ParsedQuery::ForCurrentThread();
+    ParseQuery(raw_query, query);
+    return FindTopDocuments(policy, query, document_predicate, max_result_count);
+}
 
-        sort(std::execution::seq, matched_documents.begin(), matched_documents.end(),
-             [](const Document& lhs, const Document& rhs) {
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(
+        ExecutionPolicy&& policy,
+        const std::string_view raw_query, DocumentStatus status,
+        size_t max_result_count) const {
 
-            if (std::abs(lhs.relevance - rhs.relevance) < MAX_DELTA_RELEVANCE) {
-                return lhs.rating > rhs.rating;
-            } else {
-                return lhs.relevance > rhs.relevance;
-            }
+    ParsedQuery& query = ParsedQuery::ForCurrentThread();
+    ParseQuery(raw_query, query);
+    return FindTopDocuments(policy, query, status, max_result_count);
+}
 
-        });
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(
+        ExecutionPolicy&& policy,
+        const ParsedQuery& query, DocumentPredicate document_predicate,
+        size_t max_result_count) const {
 
-        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-        }
+    TopDocumentsCollector top_documents(max_result_count);
 
+    // SEQ policy
+    if constexpr (std::is_same_v<decltype(policy), decltype(std::execution::seq)&>) {
+        FindAllDocuments(std::execution::seq, query, document_predicate, top_documents);
     } // SEQ policy end
     else // PAR policy
     if constexpr (std::is_same_v<decltype(policy), decltype(std::execution::par)&>) {
-        matched_documents = FindAllDocuments(std::execution::par, query, document_predicate);
-
-        sort(std::execution::par_unseq, matched_documents.begin(), matched_documents.end(),
-             [](const Document& lhs, const Document& rhs) {
-
-            if (std::abs(lhs.relevance - rhs.relevance) < MAX_DELTA_RELEVANCE) {
-                return lhs.rating > rhs.rating;
-            } else {
-                return lhs.relevance > rhs.relevance;
-            }
-
-        });
-
-        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-        }
+        FindAllDocuments(std::execution::par, query, document_predicate, top_documents);
     }
 
-    return matched_documents;
+    return top_documents.Extract();
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(
-        const std::execution::sequenced_policy&,
-        const Query& query, DocumentPredicate document_predicate) const {
-
-    std::map<int, double> document_to_relevance;
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(
+        ExecutionPolicy&& policy,
+        const ParsedQuery& query, DocumentStatus status,
+        size_t max_result_count) const {
 
-    for (const auto word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
-            }
-        }
+    const DocumentFilter status_predicate {status};
+    if (!result_cache_.IsEnabled()) {
+        return FindTopDocuments(policy, query, status_predicate, max_result_count);
     }
 
-    for (const auto word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
-        }
+    const ResultCacheKey& key = MakeResultCacheKey(query, status, max_result_count);
+    if (auto cached = result_cache_.Find(key)) {
+        return std::move(*cached);
     }
+    std::vector<Document> result = FindTopDocuments(policy, query, status_predicate, max_result_count);
+    result_cache_.Insert(key, result);
+    return result;
+}
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
-    }
+template <typename DocumentPredicate>
+void SearchServer::FindAllDocuments(
+        const std::execution::sequenced_policy&,
+        const ParsedQuery& query, DocumentPredicate document_predicate,
+        TopDocumentsCollector& top_documents) const {
 
-    return matched_documents;
+    auto&& scoring_predicate = PushDownFilter(document_predicate, status_index_.View());
+    ScoreDocuments(std::execution::seq, query.GetPostings(), documents_.data(), documents_.size(),
+                   scoring_predicate, top_documents);
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(
+void SearchServer::FindAllDocuments(
         const std::execution::parallel_policy&,
-        const Query& query, DocumentPredicate document_predicate) const {
-
-    ConcurrentMap<int, double> document_to_relevance_cm(16);
-
-    auto f_plus_words = [=, &document_to_relevance_cm,
-            &query, &document_predicate] (size_t begin, size_t end) {
-
-        const auto it_begin = std::next(query.plus_words.begin(), begin);
-        const auto it_end = std::next(query.plus_words.begin(), end);
-
-        std::for_each(std::execution::par_unseq, it_begin, it_end,
-            [=, &document_to_relevance_cm, &document_predicate](auto& word){
-
-                if (word_to_document_freqs_.count(word) != 0) {
-                    const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                    for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                        const auto& document_data = documents_.at(document_id);
-                        if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                            document_to_relevance_cm[document_id].ref_to_value +=
-                                term_freq * inverse_document_freq;
-                        }
-                    }
-                }
-
-            }
-        );
-
-    };
-
-    constexpr size_t THREAD_COUNT = 8;
-    size_t interval = query.plus_words.size() / THREAD_COUNT;
-    std::vector<std::future<void>> futures;
-    size_t begin = 0;
-    size_t end = interval;
-    for (size_t i = 0; i < THREAD_COUNT; ++i) {
-        futures.push_back(std::async(f_plus_words, begin, end));
-        begin = end;
-        if(i == THREAD_COUNT - 2) {
-            end = query.plus_words.size();
-        } else {
-            end += interval;
-        }
-    }
-    for (size_t i = 0; i < THREAD_COUNT; ++i) {
-        futures[i].get();
-    }
-
-    std::map<int, double> document_to_relevance =
-            document_to_relevance_cm.BuildOrdinaryMap();
-
-    for (const auto& word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
-        }
-    }
-
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
-    }
+        const ParsedQuery& query, DocumentPredicate document_predicate,
+        TopDocumentsCollector& top_documents) const {
 
-    return matched_documents;
+    auto&& scoring_predicate = PushDownFilter(document_predicate, status_index_.View());
+    ScoreDocuments(std::execution::par, *thread_pool_, query.GetPostings(), documents_.data(), documents_.size(),
+                   scoring_predicate, top_documents);
 }
@@ -0,0 +1,294 @@
+#include "segmented_search_server.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <stdexcept>
+
+#include "string_processing.h"
+
+using namespace std;
+
+SegmentedSearchServer::SegmentedSearchServer(SearchServer&& empty_segment)
+    : empty_segment_(move(empty_segment))
+    , segments_(make_shared<const SegmentList>(SegmentList{make_shared<ConcurrentSearchServer>(empty_segment_)}))
+    , merger_([this] {
+        RunMerger();
+    }) {
+}
+
+SegmentedSearchServer::~SegmentedSearchServer() {
+    {
+        lock_guard lock(write_mutex_);
+        is_stopping_ = true;
+    }
+    merge_needed_.notify_one();
+    merger_.join();
+}
+
+void SegmentedSearchServer::AddDocument(int document_id, string_view document,
+                                        DocumentStatus status, const vector<int>& ratings) {
+    lock_guard lock(write_mutex_);
+    if (document_segments_.count(document_id) > 0) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    const Segment active_segment = GetSegments()->back();
+    active_segment->AddDocument(document_id, document, status, ratings);
+    document_segments_.emplace(document_id, active_segment);
+    FreezeActiveSegmentIfFull();
+}
+
+void SegmentedSearchServer::AddDocuments(const vector<RawDocument>& documents) {
+    lock_guard lock(write_mutex_);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        if (document_segments_.count(documents[i].id) > 0) {
+            // An earlier document may fail first, the documents before the id are checked
+            // on a scratch segment so that the error is the one AddDocument would throw
+            SearchServer scratch_segment = empty_segment_;
+            scratch_segment.AddDocuments(vector<RawDocument>(documents.begin(), documents.begin() + i));
+            throw invalid_argument("Invalid document_id"s);
+        }
+    }
+    const Segment active_segment = GetSegments()->back();
+    active_segment->AddDocuments(documents);
+    for (const RawDocument& document : documents) {
+        document_segments_.emplace(document.id, active_segment);
+    }
+    FreezeActiveSegmentIfFull();
+}
+
+void SegmentedSearchServer::RemoveDocument(int document_id) {
+    lock_guard lock(write_mutex_);
+    const auto it = document_segments_.find(document_id);
+    if (it == document_segments_.end()) {
+        return;
+    }
+    it->second->RemoveDocument(document_id);
+    document_segments_.erase(it);
+    if (is_merging_) {
+        removed_during_merge_.push_back(document_id);
+    }
+}
+
+void SegmentedSearchServer::SetThreadPool(shared_ptr<ThreadPool> thread_pool) {
+    lock_guard lock(write_mutex_);
+    empty_segment_.SetThreadPool(thread_pool);
+    const auto segments = GetSegments();
+    for (const Segment& segment : *segments) {
+        segment->SetThreadPool(thread_pool);
+    }
+    atomic_store(&thread_pool_, move(thread_pool));
+}
+
+int SegmentedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    const auto segments = GetSegments();
+    for (const Segment& segment : *segments) {
+        document_count += segment->GetDocumentCount();
+    }
+    return document_count;
+}
+
+tuple<vector<string>, DocumentStatus> SegmentedSearchServer::MatchDocument(
+        const string_view raw_query, int document_id) const {
+
+    const auto segments = GetSegments();
+    for (const Segment& segment : *segments) {
+        const auto lock = segment->LockForRead();
+        const SearchServer& search_server = lock.GetServer();
+        if (search_server.document_ids_.count(document_id) == 0) {
+            continue;
+        }
+        const auto [words, status] = search_server.MatchDocument(raw_query, document_id);
+        return {vector<string>(words.begin(), words.end()), status};
+    }
+    throw out_of_range("wrong id");
+}
+
+size_t SegmentedSearchServer::GetSegmentCount() const {
+    return GetSegments()->size();
+}
+
+size_t SegmentedSearchServer::GetMaxMergeDepth() const {
+    return max_merge_depth_.load();
+}
+
+void SegmentedSearchServer::WaitForMerges() {
+    unique_lock lock(write_mutex_);
+    merge_done_.wait(lock, [this] {
+        const auto [first, last] = ChooseSegmentsToMerge(*GetSegments());
+        return !is_merging_ && first == last;
+    });
+}
+
+void SegmentedSearchServer::FreezeActiveSegmentIfFull() {
+    const auto segments = GetSegments();
+    if (static_cast<size_t>(segments->back()->GetDocumentCount()) < MAX_ACTIVE_SEGMENT_DOCUMENTS) {
+        return;
+    }
+    auto new_segments = make_shared<SegmentList>(*segments);
+    new_segments->push_back(make_shared<ConcurrentSearchServer>(empty_segment_));
+    atomic_store(&segments_, shared_ptr<const SegmentList>(move(new_segments)));
+    merge_needed_.notify_one();
+}
+
+size_t SegmentedSearchServer::GetSegmentTier(size_t document_count) {
+    size_t tier = 0;
+    for (size_t tier_limit = MAX_ACTIVE_SEGMENT_DOCUMENTS; document_count > tier_limit; tier_limit *= SEGMENT_MERGE_FACTOR) {
+        ++tier;
+    }
+    return tier;
+}
+
+pair<size_t, size_t> SegmentedSearchServer::ChooseSegmentsToMerge(const SegmentList& segments) {
+    const size_t frozen_count = segments.size() - 1;
+    if (frozen_count < SEGMENT_MERGE_FACTOR) {
+        return {0, 0};
+    }
+    vector<size_t> tiers(frozen_count);
+    for (size_t i = 0; i < frozen_count; ++i) {
+        tiers[i] = GetSegmentTier(segments[i]->GetDocumentCount());
+    }
+    // Only segments of one tier are merged, so a merge never rewrites a much larger segment
+    // along with small ones. The lowest tier goes first as the cheapest one.
+    size_t best_first = 0;
+    size_t best_tier = SIZE_MAX;
+    size_t run_first = 0;
+    for (size_t i = 0; i < frozen_count; ++i) {
+        if (tiers[i] != tiers[run_first]) {
+            run_first = i;
+        }
+        if (i + 1 - run_first == SEGMENT_MERGE_FACTOR) {
+            if (tiers[i] < best_tier) {
+                best_first = run_first;
+                best_tier = tiers[i];
+            }
+            run_first = i + 1;
+        }
+    }
+    if (best_tier == SIZE_MAX) {
+        return {0, 0};
+    }
+    return {best_first, best_first + SEGMENT_MERGE_FACTOR};
+}
+
+void SegmentedSearchServer::RunMerger() {
+    unique_lock lock(write_mutex_);
+    while (true) {
+        pair<size_t, size_t> range;
+        merge_needed_.wait(lock, [this, &range] {
+            range = ChooseSegmentsToMerge(*GetSegments());
+            return is_stopping_ || range.first != range.second;
+        });
+        if (is_stopping_) {
+            return;
+        }
+
+        // Only the merger removes segments, so the chosen ones keep their positions until it publishes
+        const auto segments = GetSegments();
+        const SegmentList sources(segments->begin() + range.first, segments->begin() + range.second);
+        SearchServer merged = empty_segment_;
+        is_merging_ = true;
+        removed_during_merge_.clear();
+        lock.unlock();
+
+        for (const Segment& source : sources) {
+            source->Read([&merged](const SearchServer& search_server) {
+                merged.MergeFrom(search_server);
+            });
+        }
+        // A merged segment never gets new documents, so its tails are compressed too
+        merged.ShrinkToFit();
+
+        lock.lock();
+        for (const int document_id : removed_during_merge_) {
+            merged.RemoveDocument(document_id);
+        }
+        is_merging_ = false;
+
+        const Segment merged_segment = make_shared<ConcurrentSearchServer>(move(merged));
+        size_t merge_depth = 0;
+        for (const Segment& source : sources) {
+            const auto it = segment_merge_depths_.find(source.get());
+            if (it != segment_merge_depths_.end()) {
+                merge_depth = max(merge_depth, it->second);
+                segment_merge_depths_.erase(it);
+            }
+        }
+        segment_merge_depths_.emplace(merged_segment.get(), merge_depth + 1);
+        if (merge_depth + 1 > max_merge_depth_.load()) {
+            max_merge_depth_.store(merge_depth + 1);
+        }
+        merged_segment->Read([&](const SearchServer& search_server) {
+            for (const int document_id : search_server) {
+                document_segments_[document_id] = merged_segment;
+            }
+        });
+        const auto current_segments = GetSegments();
+        auto new_segments = make_shared<SegmentList>(current_segments->begin(), current_segments->begin() + range.first);
+        new_segments->push_back(merged_segment);
+        new_segments->insert(new_segments->end(), current_segments->begin() + range.second, current_segments->end());
+        atomic_store(&segments_, shared_ptr<const SegmentList>(move(new_segments)));
+        merge_done_.notify_all();
+    }
+}
+
+vector<SegmentedSearchServer::SegmentQuery> SegmentedSearchServer::PrepareQuery(
+        const SegmentList& segments, string_view raw_query) const {
+
+    vector<SegmentQuery> segment_queries;
+    segment_queries.reserve(segments.size());
+    int document_count = 0;
+    for (const Segment& segment : segments) {
+        segment_queries.push_back({segment->LockForRead(), {}});
+        document_count += segment_queries.back().lock.GetServer().GetDocumentCount();
+    }
+
+    // Words are validated by every segment the same way, stop words are the same too
+    vector<SearchServer::QueryWord> query_words(segments.size());
+    // Repeated words are scored once, as in SearchServer
+    set<pair<string_view, bool>> seen_words;
+    vector<string_view> words;
+    const size_t invalid_word_index = SplitIntoValidWords(raw_query, words);
+    for (size_t w = 0; w < words.size(); ++w) {
+        size_t document_freq = 0;
+        for (size_t i = 0; i < segment_queries.size(); ++i) {
+            const SearchServer& search_server = segment_queries[i].lock.GetServer();
+            query_words[i] = search_server.ParseQueryWord(words[w], w != invalid_word_index);
+        }
+        if (!seen_words.emplace(query_words[0].data, query_words[0].is_minus).second) {
+            continue;
+        }
+        for (size_t i = 0; i < segment_queries.size(); ++i) {
+            const SearchServer& search_server = segment_queries[i].lock.GetServer();
+            if (query_words[i].term) {
+                document_freq += search_server.GetDocumentFreq(*query_words[i].term);
+            }
+        }
+        if (query_words[0].is_stop || document_freq == 0) {
+            continue;
+        }
+
+        const double inverse_document_freq = log(document_count * 1.0 / document_freq);
+        for (size_t i = 0; i < segment_queries.size(); ++i) {
+            if (!query_words[i].term) {
+                continue;
+            }
+            const SearchServer& search_server = segment_queries[i].lock.GetServer();
+            const PostingListView postings = search_server.word_to_document_freqs_[*query_words[i].term].View();
+            if (query_words[i].is_minus) {
+                segment_queries[i].query_postings.minus_postings.push_back(postings);
+            } else if (search_server.GetDocumentFreq(*query_words[i].term) > 0) {
+                segment_queries[i].query_postings.plus_postings.push_back({postings, inverse_document_freq});
+            }
+        }
+    }
+
+    for (SegmentQuery& segment_query : segment_queries) {
+        const SearchServer& search_server = segment_query.lock.GetServer();
+        if (!segment_query.query_postings.plus_postings.empty() && !search_server.removed_documents_.empty()) {
+            segment_query.query_postings.minus_postings.push_back(search_server.GetRemovedDocuments());
+        }
+    }
+    return segment_queries;
+}
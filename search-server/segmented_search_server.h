@@ -0,0 +1,211 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <execution>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "concurrent_search_server.h"
+#include "document.h"
+#include "document_filter.h"
+#include "document_scoring.h"
+#include "search_server.h"
+#include "thread_pool.h"
+#include "top_documents.h"
+
+// New documents go into the active segment until it holds that many documents
+const size_t MAX_ACTIVE_SEGMENT_DOCUMENTS {4096};
+// Number of consecutive frozen segments of one size tier merged into one
+const size_t SEGMENT_MERGE_FACTOR {4};
+
+// Search index split into segments (LSM-style) for steady ingestion.
+// Documents are added to a small active segment. A full active segment is
+// frozen and a new one is started; a background thread merges runs of
+// SEGMENT_MERGE_FACTOR frozen segments of the same size tier into one,
+// dropping removed documents physically. A merged segment moves up a tier,
+// so every document is rewritten O(log N) times and there are O(log N) segments.
+// Every segment is a ConcurrentSearchServer and the segment list is published
+// atomically, so queries are blocked neither by ingestion nor by merges.
+// Relevance is computed with the statistics of the whole index, results are
+// the same as of a single SearchServer holding all the documents.
+class SegmentedSearchServer {
+public:
+    template <typename StringContainer>
+    explicit SegmentedSearchServer(const StringContainer& stop_words)
+        : SegmentedSearchServer(SearchServer(stop_words)) {
+    }
+
+    explicit SegmentedSearchServer(const std::string_view stop_words_text)
+        : SegmentedSearchServer(SearchServer(stop_words_text)) {
+    }
+
+    explicit SegmentedSearchServer(const std::string& stop_words_text)
+        : SegmentedSearchServer(static_cast<std::string_view>(stop_words_text)) {
+    }
+
+    SegmentedSearchServer(const SegmentedSearchServer&) = delete;
+    SegmentedSearchServer& operator=(const SegmentedSearchServer&) = delete;
+
+    // Stops the merger, a merge in progress is finished first
+    ~SegmentedSearchServer();
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    // Same contract as SearchServer::AddDocuments, ids are checked against the whole index
+    void AddDocuments(const std::vector<RawDocument>& documents);
+
+    void RemoveDocument(int document_id);
+
+    void SetThreadPool(std::shared_ptr<ThreadPool> thread_pool);
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(
+            ExecutionPolicy&& policy,
+            const std::string_view raw_query, DocumentPredicate document_predicate,
+            size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(
+            const std::string_view raw_query, DocumentPredicate document_predicate,
+            size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const {
+        return FindTopDocuments(std::execution::seq, raw_query, document_predicate, max_result_count);
+    }
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(
+            ExecutionPolicy&& policy,
+            const std::string_view raw_query, DocumentStatus status,
+            size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const {
+        return FindTopDocuments(policy, raw_query, DocumentFilter {status}, max_result_count);
+    }
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(
+            ExecutionPolicy&& policy, const std::string_view raw_query) const {
+        return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+    }
+
+    std::vector<Document> FindTopDocuments(
+            std::string_view raw_query, DocumentStatus status,
+            size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const {
+        return FindTopDocuments(std::execution::seq, raw_query, status, max_result_count);
+    }
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const {
+        return FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
+    }
+
+    int GetDocumentCount() const;
+
+    // Words are copied: the segment holding the document may be merged away right after the call
+    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(
+            const std::string_view raw_query, int document_id) const;
+
+    size_t GetSegmentCount() const;
+
+    // The largest number of merges any document went through
+    size_t GetMaxMergeDepth() const;
+
+    // Blocks until there is nothing left to merge
+    void WaitForMerges();
+
+private:
+    using Segment = std::shared_ptr<ConcurrentSearchServer>;
+    // The last segment is the active one
+    using SegmentList = std::vector<Segment>;
+
+    struct SegmentQuery {
+        ConcurrentSearchServer::ReadLock lock;
+        QueryPostings query_postings;
+    };
+
+    // New segments are copies of the empty one
+    SearchServer empty_segment_;
+    // Both are replaced as a whole with std::atomic_store, readers take them with std::atomic_load
+    std::shared_ptr<ThreadPool> thread_pool_ = ThreadPool::GetDefault();
+    std::shared_ptr<const SegmentList> segments_;
+
+    // Guards everything below and the changes of segments_
+    std::mutex write_mutex_;
+    std::unordered_map<int, Segment> document_segments_;
+    // Number of merges behind every merged segment, segments missing here were never merged
+    std::unordered_map<const ConcurrentSearchServer*, size_t> segment_merge_depths_;
+    std::atomic<size_t> max_merge_depth_ = 0;
+    bool is_merging_ = false;
+    bool is_stopping_ = false;
+    // Documents removed while a merge is in progress are removed from its result too
+    std::vector<int> removed_during_merge_;
+    std::condition_variable merge_needed_;
+    std::condition_variable merge_done_;
+    std::thread merger_;
+
+    explicit SegmentedSearchServer(SearchServer&& empty_segment);
+
+    std::shared_ptr<const SegmentList> GetSegments() const {
+        return std::atomic_load(&segments_);
+    }
+
+    // Starts a new active segment if the current one is full, write_mutex_ must be held
+    void FreezeActiveSegmentIfFull();
+
+    // Tier 0 holds segments of at most MAX_ACTIVE_SEGMENT_DOCUMENTS documents,
+    // every next tier holds segments up to SEGMENT_MERGE_FACTOR times larger
+    static size_t GetSegmentTier(size_t document_count);
+
+    // Returns the range of frozen segments to merge next, an empty one if no merge is needed
+    static std::pair<size_t, size_t> ChooseSegmentsToMerge(const SegmentList& segments);
+
+    void RunMerger();
+
+    // Locks every segment and finds postings of the query words in it,
+    // inverse document freqs are computed over all the segments
+    std::vector<SegmentQuery> PrepareQuery(const SegmentList& segments, std::string_view raw_query) const;
+};
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(
+        ExecutionPolicy&& policy,
+        const std::string_view raw_query, DocumentPredicate document_predicate,
+        size_t max_result_count) const {
+
+    const auto segments = GetSegments();
+    const std::vector<SegmentQuery> segment_queries = PrepareQuery(*segments, raw_query);
+
+    TopDocumentsCollector top_documents(max_result_count);
+
+    if constexpr (std::is_same_v<decltype(policy), decltype(std::execution::seq)&>) {
+        for (const SegmentQuery& segment_query : segment_queries) {
+            const SearchServer& search_server = segment_query.lock.GetServer();
+            auto&& scoring_predicate = PushDownFilter(document_predicate, search_server.status_index_.View());
+            ScoreDocuments(std::execution::seq, segment_query.query_postings,
+                           search_server.documents_.data(), search_server.documents_.size(),
+                           scoring_predicate, top_documents);
+        }
+    } else if constexpr (std::is_same_v<decltype(policy), decltype(std::execution::par)&>) {
+        // Segments are scored in parallel, every segment is split further by its own postings
+        const auto thread_pool = std::atomic_load(&thread_pool_);
+        std::vector<TopDocumentsCollector> partial_top_documents(
+                segment_queries.size(), TopDocumentsCollector(max_result_count));
+        thread_pool->ParallelFor(segment_queries.size(), [&](size_t task) {
+            const SegmentQuery& segment_query = segment_queries[task];
+            const SearchServer& search_server = segment_query.lock.GetServer();
+            auto&& scoring_predicate = PushDownFilter(document_predicate, search_server.status_index_.View());
+            ScoreDocuments(std::execution::par, *thread_pool, segment_query.query_postings,
+                           search_server.documents_.data(), search_server.documents_.size(),
+                           scoring_predicate, partial_top_documents[task]);
+        });
+        for (const auto& partial : partial_top_documents) {
+            top_documents.Merge(partial);
+        }
+    }
+
+    return top_documents.Extract();
+}
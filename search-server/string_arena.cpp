@@ -0,0 +1,24 @@
+#include "string_arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+string_view StringArena::Store(string_view text) {
+    if (text.empty()) {
+        return {};
+    }
+    if (chunks_.empty() || chunks_.back().capacity - chunks_.back().size < text.size()) {
+        const size_t next_capacity = chunks_.empty() ? MIN_CHUNK_SIZE : min(chunks_.back().capacity * 2, MAX_CHUNK_SIZE);
+        // A string longer than a chunk gets a chunk of its own
+        const size_t capacity = max(next_capacity, text.size());
+        // Not value initialized, pages are touched only when strings are written
+        chunks_.push_back({unique_ptr<char[]>(new char[capacity]), capacity, 0});
+    }
+    Chunk& chunk = chunks_.back();
+    char* data = chunk.data.get() + chunk.size;
+    memcpy(data, text.data(), text.size());
+    chunk.size += text.size();
+    return {data, text.size()};
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Append-only storage for many small strings.
+// Strings are copied back to back into chunks, so storing one costs no separate
+// heap allocation. Chunks grow geometrically up to MAX_CHUNK_SIZE, which is
+// the size of a huge page. Chunks never move, views into them stay valid
+// until the arena is destroyed, moving the arena keeps them valid too.
+class StringArena {
+public:
+    static constexpr size_t MIN_CHUNK_SIZE = 4096;
+    static constexpr size_t MAX_CHUNK_SIZE = 2 << 20;
+
+    StringArena() = default;
+
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+
+    StringArena(StringArena&&) = default;
+    StringArena& operator=(StringArena&&) = default;
+
+    // Returns the view of the stored copy
+    std::string_view Store(std::string_view text);
+
+private:
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t capacity;
+        size_t size;
+    };
+
+    std::vector<Chunk> chunks_;
+};
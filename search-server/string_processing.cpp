@@ -1,22 +1,145 @@
 #include "string_processing.h"
 
+#include <stdexcept>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define SEARCH_SERVER_X86_SIMD
+#endif
+
 using namespace std;
 
-vector<string_view> SplitIntoWords(const string_view str) {
+namespace {
 
-    vector<string_view> result;
-    int64_t pos = 0;
-    const int64_t pos_end = str.npos;
-
-    while (true) {
-        int64_t space = str.find(' ', pos);
-        result.push_back(space == pos_end ? str.substr(pos) : str.substr(pos, space - pos));
-        if (space == pos_end) {
-            break;
-        } else {
-            pos = space + 1;
+// Each tokenizer returns the position of the first control character or string_view::npos
+
+// Processes text from pos on, start is the beginning of the current word
+size_t SplitScalar(const string_view text, size_t pos, size_t start, size_t invalid_pos,
+                   vector<string_view>& words) {
+    for (; pos < text.size(); ++pos) {
+        const unsigned char c = text[pos];
+        if (c == ' ') {
+            words.push_back(text.substr(start, pos - start));
+            start = pos + 1;
+        } else if (c < ' ' && invalid_pos == string_view::npos) {
+            invalid_pos = pos;
         }
     }
+    words.push_back(text.substr(start));
+    return invalid_pos;
+}
+
+#ifndef SEARCH_SERVER_X86_SIMD
+
+size_t SplitScalar(const string_view text, vector<string_view>& words) {
+    return SplitScalar(text, 0, 0, string_view::npos, words);
+}
+
+#else
 
+// A byte is a control character if max(byte, 31) == 31
+size_t SplitSse2(const string_view text, vector<string_view>& words) {
+    const __m128i spaces = _mm_set1_epi8(' ');
+    const __m128i max_control = _mm_set1_epi8(' ' - 1);
+    size_t start = 0;
+    size_t invalid_pos = string_view::npos;
+    size_t pos = 0;
+    for (; pos + 16 <= text.size(); pos += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + pos));
+        if (invalid_pos == string_view::npos) {
+            const unsigned control_mask = _mm_movemask_epi8(
+                    _mm_cmpeq_epi8(_mm_max_epu8(chunk, max_control), max_control));
+            if (control_mask != 0) {
+                invalid_pos = pos + __builtin_ctz(control_mask);
+            }
+        }
+        for (unsigned space_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, spaces));
+                space_mask != 0; space_mask &= space_mask - 1) {
+            const size_t space = pos + __builtin_ctz(space_mask);
+            words.push_back(text.substr(start, space - start));
+            start = space + 1;
+        }
+    }
+    return SplitScalar(text, pos, start, invalid_pos, words);
+}
+
+__attribute__((target("avx2")))
+size_t SplitAvx2(const string_view text, vector<string_view>& words) {
+    const __m256i spaces = _mm256_set1_epi8(' ');
+    const __m256i max_control = _mm256_set1_epi8(' ' - 1);
+    size_t start = 0;
+    size_t invalid_pos = string_view::npos;
+    size_t pos = 0;
+    for (; pos + 32 <= text.size(); pos += 32) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + pos));
+        if (invalid_pos == string_view::npos) {
+            const unsigned control_mask = _mm256_movemask_epi8(
+                    _mm256_cmpeq_epi8(_mm256_max_epu8(chunk, max_control), max_control));
+            if (control_mask != 0) {
+                invalid_pos = pos + __builtin_ctz(control_mask);
+            }
+        }
+        for (unsigned space_mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, spaces));
+                space_mask != 0; space_mask &= space_mask - 1) {
+            const size_t space = pos + __builtin_ctz(space_mask);
+            words.push_back(text.substr(start, space - start));
+            start = space + 1;
+        }
+    }
+    return SplitScalar(text, pos, start, invalid_pos, words);
+}
+
+#endif
+
+using SplitFunction = size_t (*)(const string_view, vector<string_view>&);
+
+SplitFunction ChooseSplitFunction() {
+#ifdef SEARCH_SERVER_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SplitAvx2;
+    }
+    return SplitSse2;
+#else
+    return SplitScalar;
+#endif
+}
+
+} // namespace
+
+size_t SplitIntoValidWords(const string_view text, vector<string_view>& words) {
+    // Chosen on the first call, so that servers built during static initialization can split too
+    static const SplitFunction split_function = ChooseSplitFunction();
+    words.clear();
+    const size_t invalid_pos = split_function(text, words);
+    if (invalid_pos == string_view::npos) {
+        return words.size();
+    }
+    // The control character is not a space, so it lies inside the first word ending after it
+    const char* const invalid_char = text.data() + invalid_pos;
+    return lower_bound(words.begin(), words.end(), invalid_char,
+        [](const string_view word, const char* c) {
+            return word.data() + word.size() <= c;
+        }) - words.begin();
+}
+
+QueryWordText ParseQueryWordText(const string_view text, bool is_valid) {
+    if (text.empty()) {
+        throw invalid_argument("Query word is empty"s);
+    }
+    QueryWordText result {text, false};
+    if (result.word[0] == '-') {
+        result.is_minus = true;
+        result.word.remove_prefix(1);
+    }
+    if (result.word.empty() || result.word[0] == '-' || !is_valid) {
+        throw invalid_argument("Query word "s + static_cast<string>(text) + " is invalid"s);
+    }
+    return result;
+}
+
+vector<string_view> SplitIntoWords(const string_view str) {
+    vector<string_view> result;
+    SplitIntoValidWords(str, result);
     return result;
 }
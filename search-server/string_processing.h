@@ -1,18 +1,35 @@
 #pragma once
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <set>
 
 std::vector<std::string_view> SplitIntoWords(const std::string_view text);
 
+// Splits text by spaces into words and checks them for control characters in a single pass.
+// words is cleared first, so the caller can reuse its buffer.
+// Returns the index of the first word with a control character or words.size() if there is none.
+// Uses AVX2 or SSE2 when the CPU supports them.
+size_t SplitIntoValidWords(const std::string_view text, std::vector<std::string_view>& words);
+
+struct QueryWordText {
+    std::string_view word; // without the minus sign
+    bool is_minus;
+};
+
+// Strips the minus sign of a query word. Shared by all servers, so that they reject the same queries.
+// Control characters are found by SplitIntoValidWords, is_valid is false for the word it reports.
+// Throws std::invalid_argument if the word is empty, starts with two minuses or is not valid.
+QueryWordText ParseQueryWordText(const std::string_view text, bool is_valid);
+
 template <typename StringContainer>
 std::set<std::string_view, std::less<>> MakeUniqueNonEmptyStrings(
         const StringContainer& strings) {
 
     std::set<std::string_view, std::less<>> non_empty_strings;
 
-    for (const auto str : strings) {
+    for (const auto& str : strings) {
         if (!str.empty()) {
             non_empty_strings.insert(str);
         }
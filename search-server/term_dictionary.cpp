@@ -0,0 +1,31 @@
+#include "term_dictionary.h"
+
+using namespace std;
+
+TermDictionary::TermDictionary(const TermDictionary& other) {
+    terms_.reserve(other.terms_.size());
+    term_ids_.reserve(other.terms_.size());
+    for (const string_view term : other.terms_) {
+        Intern(term);
+    }
+}
+
+TermDictionary& TermDictionary::operator=(const TermDictionary& other) {
+    if (this != &other) {
+        TermDictionary copy(other);
+        *this = move(copy);
+    }
+    return *this;
+}
+
+TermId TermDictionary::Intern(string_view term) {
+    const auto it = term_ids_.find(term);
+    if (it != term_ids_.end()) {
+        return it->second;
+    }
+    const TermId id = terms_.size();
+    const string_view stored_term = arena_.Store(term);
+    terms_.push_back(stored_term);
+    term_ids_.emplace(stored_term, id);
+    return id;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "string_arena.h"
+
+// Dense number of an interned term, ids are handed out from 0 in order of interning
+using TermId = uint32_t;
+
+const TermId NO_TERM = std::numeric_limits<TermId>::max();
+
+// Interns every distinct term string to a TermId.
+// The dictionary owns term strings in an arena, views returned by GetTerm
+// stay valid until the dictionary is compacted or destroyed.
+class TermDictionary {
+public:
+    TermDictionary() = default;
+
+    // Keys of a copied dictionary must point into its own arena
+    TermDictionary(const TermDictionary& other);
+    TermDictionary& operator=(const TermDictionary& other);
+
+    TermDictionary(TermDictionary&&) = default;
+    TermDictionary& operator=(TermDictionary&&) = default;
+
+    // Returns the id of the term adding it to the dictionary if needed
+    TermId Intern(std::string_view term);
+
+    std::optional<TermId> Find(std::string_view term) const {
+        const auto it = term_ids_.find(term);
+        if (it == term_ids_.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    std::string_view GetTerm(TermId term) const {
+        return terms_[term];
+    }
+
+    size_t size() const {
+        return terms_.size();
+    }
+
+    // Drops the terms keep(term) returns false for and renumbers the rest keeping their order,
+    // strings of the kept terms are moved into a new arena.
+    // Returns new ids indexed by old ids, dropped terms get NO_TERM.
+    template <typename Predicate>
+    std::vector<TermId> Compact(Predicate keep);
+
+private:
+    StringArena arena_;
+    std::vector<std::string_view> terms_;
+    std::unordered_map<std::string_view, TermId> term_ids_;
+};
+
+template <typename Predicate>
+std::vector<TermId> TermDictionary::Compact(Predicate keep) {
+    std::vector<TermId> new_ids(terms_.size(), NO_TERM);
+    TermDictionary compacted;
+    for (TermId term = 0; term < terms_.size(); ++term) {
+        if (keep(term)) {
+            new_ids[term] = compacted.Intern(terms_[term]);
+        }
+    }
+    *this = std::move(compacted);
+    return new_ids;
+}
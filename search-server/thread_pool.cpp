@@ -0,0 +1,98 @@
+#include "thread_pool.h"
+
+using namespace std;
+
+namespace {
+
+// Pool and queue index of the worker running on the current thread
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_queue_index = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t worker_count) {
+    for (size_t i = 0; i < worker_count; ++i) {
+        queues_.push_back(make_unique<TaskQueue>());
+    }
+    for (size_t i = 0; i < worker_count; ++i) {
+        threads_.emplace_back([this, i] {
+            WorkerLoop(i);
+        });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard guard(wake_mutex_);
+        stopped_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+shared_ptr<ThreadPool> ThreadPool::GetDefault() {
+    static const auto pool = make_shared<ThreadPool>();
+    return pool;
+}
+
+void ThreadPool::Push(function<void()> task) {
+    // Workers keep their own subtasks local, other threads spread tasks round-robin
+    const size_t queue_index = current_pool == this
+            ? current_queue_index
+            : next_queue_++ % queues_.size();
+    {
+        lock_guard guard(queues_[queue_index]->mutex);
+        queues_[queue_index]->tasks.push_back(move(task));
+    }
+    {
+        lock_guard guard(wake_mutex_);
+        ++queued_task_count_;
+    }
+    wake_.notify_one();
+}
+
+bool ThreadPool::TryPop(size_t queue_index, function<void()>& task) {
+    {
+        TaskQueue& own = *queues_[queue_index];
+        lock_guard guard(own.mutex);
+        if (!own.tasks.empty()) {
+            task = move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues_.size(); ++i) {
+        TaskQueue& victim = *queues_[(queue_index + i) % queues_.size()];
+        lock_guard guard(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::WorkerLoop(size_t queue_index) {
+    current_pool = this;
+    current_queue_index = queue_index;
+
+    function<void()> task;
+    while (true) {
+        if (TryPop(queue_index, task)) {
+            --queued_task_count_;
+            task();
+            task = nullptr;
+            continue;
+        }
+        unique_lock lock(wake_mutex_);
+        wake_.wait(lock, [this] {
+            return stopped_ || queued_task_count_ > 0;
+        });
+        if (stopped_ && queued_task_count_ == 0) {
+            return;
+        }
+    }
+}
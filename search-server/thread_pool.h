@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent pool of worker threads with per-worker task queues.
+// A worker takes tasks from the back of its own queue and steals
+// from the front of the other queues when its own queue is empty.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t worker_count = std::thread::hardware_concurrency());
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool();
+
+    // Process-wide pool sized to the hardware
+    static std::shared_ptr<ThreadPool> GetDefault();
+
+    size_t GetWorkerCount() const {
+        return threads_.size();
+    }
+
+    // Number of tasks worth splitting work_size units of work into:
+    // at least min_task_size units per task and no more tasks than threads
+    size_t GetTaskCount(size_t work_size, size_t min_task_size) const {
+        return std::clamp<size_t>(work_size / std::max<size_t>(min_task_size, 1), 1, GetWorkerCount() + 1);
+    }
+
+    // Calls func(task) for every task in [0, task_count) and waits for all of them.
+    // The calling thread executes tasks too, so nested calls from workers cannot deadlock.
+    // The first exception thrown by func is rethrown here.
+    template <typename Func>
+    void ParallelFor(size_t task_count, Func func);
+
+private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    struct ParallelForState {
+        std::atomic<size_t> next_task {0};
+        std::atomic<size_t> done_task_count {0};
+        std::mutex mutex;
+        std::condition_variable all_done;
+        std::exception_ptr exception;
+    };
+
+    std::vector<std::unique_ptr<TaskQueue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> queued_task_count_ {0};
+    std::atomic<size_t> next_queue_ {0};
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    bool stopped_ = false;
+
+    void Push(std::function<void()> task);
+    bool TryPop(size_t queue_index, std::function<void()>& task);
+    void WorkerLoop(size_t queue_index);
+};
+
+template <typename Func>
+void ThreadPool::ParallelFor(size_t task_count, Func func) {
+    if (task_count == 0) {
+        return;
+    }
+    auto state = std::make_shared<ParallelForState>();
+
+    // Helpers that start after all tasks are taken return without touching func
+    auto run_tasks = [state, task_count, &func] {
+        for (size_t task; (task = state->next_task++) < task_count;) {
+            try {
+                func(task);
+            } catch (...) {
+                std::lock_guard guard(state->mutex);
+                if (!state->exception) {
+                    state->exception = std::current_exception();
+                }
+            }
+            if (++state->done_task_count == task_count) {
+                std::lock_guard guard(state->mutex);
+                state->all_done.notify_all();
+            }
+        }
+    };
+
+    const size_t helper_count = std::min(task_count - 1, GetWorkerCount());
+    for (size_t i = 0; i < helper_count; ++i) {
+        Push(run_tasks);
+    }
+    run_tasks();
+
+    std::unique_lock lock(state->mutex);
+    state->all_done.wait(lock, [&state, task_count] {
+        return state->done_task_count == task_count;
+    });
+    if (state->exception) {
+        std::rethrow_exception(state->exception);
+    }
+}
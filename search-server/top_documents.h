@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "document.h"
+
+const double MAX_DELTA_RELEVANCE {1e-6};
+const size_t MAX_RESERVED_DOCUMENT_COUNT {1024};
+
+// Ranking order of search results: higher relevance first, rating breaks ties.
+// The id breaks the rest, so that results with different max counts are prefixes of one ranking.
+inline bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < MAX_DELTA_RELEVANCE) {
+        if (lhs.rating != rhs.rating) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+// Keeps the max_count best documents seen so far in a bounded heap.
+// The heap top is the worst kept document, so a candidate is compared with it only once.
+// Room is reserved for at most MAX_RESERVED_DOCUMENT_COUNT documents and the heap grows past
+// that on demand, so max_count may be as large as SIZE_MAX to keep every document.
+class TopDocumentsCollector {
+public:
+    explicit TopDocumentsCollector(size_t max_count)
+        : max_count_(max_count) {
+        heap_.reserve(std::min(max_count_, MAX_RESERVED_DOCUMENT_COUNT));
+    }
+
+    void Add(const Document& document) {
+        if (heap_.size() < max_count_) {
+            heap_.push_back(document);
+            std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        } else if (max_count_ > 0 && IsMoreRelevant(document, heap_.front())) {
+            std::pop_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+            heap_.back() = document;
+            std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        }
+    }
+
+    void Merge(const TopDocumentsCollector& other) {
+        for (const Document& document : other.heap_) {
+            Add(document);
+        }
+    }
+
+    size_t GetMaxCount() const {
+        return max_count_;
+    }
+
+    size_t size() const {
+        return heap_.size();
+    }
+
+    // Kept documents in heap order
+    const std::vector<Document>& GetDocuments() const {
+        return heap_;
+    }
+
+    // Returns the kept documents ordered from the most relevant
+    std::vector<Document> Extract() {
+        std::sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        std::vector<Document> result = std::move(heap_);
+        heap_.clear();
+        return result;
+    }
+
+private:
+    size_t max_count_;
+    std::vector<Document> heap_;
+};
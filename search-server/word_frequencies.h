@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <string_view>
+#include <utility>
+
+#include "term_dictionary.h"
+
+// Forward index entry, words of a document are sorted by term
+struct WordFreq {
+    TermId term;
+    double term_freq;
+};
+
+// Read-only view of the words of a document with their term freqs in the order of TermIds.
+// Iterating it yields std::pair<std::string_view, double> like the map of SearchServer::GetWordFrequencies
+// without copying anything. The view is valid until the server is modified.
+class WordFrequenciesView {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator() = default;
+
+        Iterator(const WordFreq* word_freq, const TermDictionary* terms)
+            : word_freq_(word_freq), terms_(terms) {
+        }
+
+        value_type operator*() const {
+            return {terms_->GetTerm(word_freq_->term), word_freq_->term_freq};
+        }
+
+        Iterator& operator++() {
+            ++word_freq_;
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator result = *this;
+            ++word_freq_;
+            return result;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return word_freq_ == other.word_freq_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return word_freq_ != other.word_freq_;
+        }
+
+    private:
+        const WordFreq* word_freq_ = nullptr;
+        const TermDictionary* terms_ = nullptr;
+    };
+
+    WordFrequenciesView() = default;
+
+    WordFrequenciesView(const WordFreq* begin, const WordFreq* end, const TermDictionary* terms)
+        : begin_(begin), end_(end), terms_(terms) {
+    }
+
+    Iterator begin() const {
+        return {begin_, terms_};
+    }
+
+    Iterator end() const {
+        return {end_, terms_};
+    }
+
+    size_t size() const {
+        return end_ - begin_;
+    }
+
+    bool empty() const {
+        return begin_ == end_;
+    }
+
+    // Entries sorted by term, TermIds are comparable only within one server
+    const WordFreq* GetWordFreqs() const {
+        return begin_;
+    }
+
+private:
+    const WordFreq* begin_ = nullptr;
+    const WordFreq* end_ = nullptr;
+    const TermDictionary* terms_ = nullptr;
+};